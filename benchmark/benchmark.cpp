@@ -0,0 +1,583 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../core/camera.h"
+#include "../core/frame.h"
+#include "../core/jobsystem.h"
+#include "../core/macro.h"
+#include "../core/model.h"
+#include "../core/pipeline.h"
+#include "../core/scene.h"
+#include "../core/synthetic.h"
+#include "../shader/shader.h"
+
+// replays a fixed camera path through the built-in scenes at fixed resolutions and thread
+// counts and writes the timings of every frame as json. the frames are drawn synchronously
+// on the main thread and are never presented, so only the rendering itself is measured.
+// run it from bin/ like SRender, the scenes load their assets relative to it. synthetic workloads
+// of a given triangle count, overdraw and texture size can be run in place of the scenes to see how
+// the renderer scales
+
+const vec3 Eye(0, 1, 5);
+const vec3 Up(0, 1, 0);
+const vec3 Target(0, 1, 0);
+
+typedef struct
+{
+	int width;
+	int height;
+} resolution_t;
+
+// a built-in scene or a generated model drawn with the phong shader
+typedef struct
+{
+	const scene_t *scene;			// NULL for a synthetic workload
+	synthetic_desc_t synthetic;
+} workload_t;
+
+typedef struct
+{
+	std::vector<workload_t> workloads;
+	std::vector<resolution_t> resolutions;
+	std::vector<int> thread_counts;
+	std::vector<draw_mode> modes;
+	int num_frames;
+	int num_warmup;
+	const char *path_filename;		// NULL for the built-in orbit
+	const char *output_filename;
+	unsigned int synthetic_flags;	// MESH_FLAG_XXX processing of the synthetic meshes
+} options_t;
+
+// one measured frame
+typedef struct
+{
+	double prepare_ms;				// clear, cull and draw the occluders
+	double draw_ms;					// shade, resolve and draw the sky
+	int visible_models;
+	int drawn_models;
+	int covered_pixels;
+	draw_counters_t counters;
+} frame_sample_t;
+
+typedef struct
+{
+	std::string workload_name;
+	long long num_triangles;		// faces of the full detail meshes
+	int texture_size;				// 0 for the built-in scenes
+	resolution_t resolution;
+	int num_threads;
+	draw_mode mode;
+	std::vector<frame_sample_t> samples;
+} benchmark_run_t;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/* camera path */
+// one orbit around the target, moving in to half the distance and up and down on the way, so
+// the path covers the levels of detail, near plane clipping and occlusion of every scene
+static void build_orbit_path(int num_poses, std::vector<camera_pose_t> &poses)
+{
+	vec3 offset = Eye - Target;
+	float distance = (float)offset.norm();
+	for (int i = 0; i < num_poses; i++)
+	{
+		float angle = 2 * PI * i / num_poses;
+		float radius = distance * (0.75f + 0.25f * (float)cos(angle));
+		float height = 0.5f * (float)sin(2 * angle);
+		camera_pose_t pose;
+		pose.eye = Target + vec3(radius * (float)sin(angle), height, radius * (float)cos(angle));
+		pose.target = Target;
+		poses.push_back(pose);
+	}
+}
+
+/* statistics */
+// nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	int rank = (int)ceil(p / 100.0 * sorted.size());
+	return sorted[std::max(rank, 1) - 1];
+}
+
+static void write_summary(FILE *file, const char *name, std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	double sum = 0;
+	for (size_t i = 0; i < values.size(); i++)
+		sum += values[i];
+	double mean = values.empty() ? 0 : sum / values.size();
+
+	fprintf(file, "\t\t\t\"%s\": {\"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+		name, mean, values.empty() ? 0 : values.front(), percentile(values, 50), percentile(values, 90),
+		percentile(values, 99), values.empty() ? 0 : values.back());
+}
+
+static void write_json(FILE *file, const options_t &options, const std::vector<benchmark_run_t> &runs)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "\t\"camera_path\": \"%s\",\n", options.path_filename ? options.path_filename : "orbit");
+	fprintf(file, "\t\"warmup_frames\": %d,\n", options.num_warmup);
+	fprintf(file, "\t\"frames\": %d,\n", options.num_frames);
+	fprintf(file, "\t\"runs\": [\n");
+	for (size_t r = 0; r < runs.size(); r++)
+	{
+		const benchmark_run_t &run = runs[r];
+		const std::vector<frame_sample_t> &samples = run.samples;
+
+		std::vector<double> frame_ms, prepare_ms, draw_ms;
+		double total_ms = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			frame_ms.push_back(samples[i].prepare_ms + samples[i].draw_ms);
+			prepare_ms.push_back(samples[i].prepare_ms);
+			draw_ms.push_back(samples[i].draw_ms);
+			total_ms += frame_ms.back();
+		}
+
+		fprintf(file, "\t\t{\n");
+		fprintf(file, "\t\t\t\"scene\": \"%s\",\n", run.workload_name.c_str());
+		fprintf(file, "\t\t\t\"triangles\": %lld,\n", run.num_triangles);
+		fprintf(file, "\t\t\t\"texture_size\": %d,\n", run.texture_size);
+		fprintf(file, "\t\t\t\"width\": %d,\n", run.resolution.width);
+		fprintf(file, "\t\t\t\"height\": %d,\n", run.resolution.height);
+		fprintf(file, "\t\t\t\"threads\": %d,\n", run.num_threads);
+		fprintf(file, "\t\t\t\"draw_mode\": \"%s\",\n", draw_mode_name(run.mode));
+		fprintf(file, "\t\t\t\"fps\": %.3f,\n", total_ms > 0 ? samples.size() * 1000.0 / total_ms : 0);
+		write_summary(file, "frame_ms", frame_ms);
+		fprintf(file, ",\n");
+		write_summary(file, "prepare_ms", prepare_ms);
+		fprintf(file, ",\n");
+		write_summary(file, "draw_ms", draw_ms);
+		fprintf(file, ",\n");
+
+		// every frame as an array of the frame_fields
+		fprintf(file, "\t\t\t\"frame_fields\": [\"prepare_ms\", \"draw_ms\", \"visible_models\", \"drawn_models\", \"meshlets\", \"vertices\", "
+			"\"faces\", \"clip_culled\", \"backface_culled\", \"rasterized\", \"fragments\", \"depth_failed\", \"shaded\", \"covered_pixels\"],\n");
+		fprintf(file, "\t\t\t\"frames\": [");
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			const frame_sample_t &s = samples[i];
+			const draw_counters_t &c = s.counters;
+			fprintf(file, "%s\n\t\t\t\t[%.4f, %.4f, %d, %d, %lld, %lld, %lld, %lld, %lld, %lld, %lld, %lld, %lld, %d]", i ? "," : "",
+				s.prepare_ms, s.draw_ms, s.visible_models, s.drawn_models, c.meshlets, c.vertices, c.faces, c.clip_culled,
+				c.backface_culled, c.rasterized, c.fragments, c.depth_failed, c.shaded, s.covered_pixels);
+		}
+		fprintf(file, "\n\t\t\t]\n");
+		fprintf(file, "\t\t}%s\n", r + 1 < runs.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+}
+
+/* workloads */
+static std::string workload_name(const workload_t &workload)
+{
+	if (workload.scene != NULL)
+		return workload.scene->scene_name;
+
+	const synthetic_desc_t &desc = workload.synthetic;
+	char name[128];
+	if (desc.shape == SYNTHETIC_OVERDRAW)
+		snprintf(name, sizeof(name), "%s-%lld-t%d-x%d", synthetic_shape_name(desc.shape), desc.num_triangles,
+			desc.texture_size, desc.num_layers);
+	else
+		snprintf(name, sizeof(name), "%s-%lld-t%d", synthetic_shape_name(desc.shape), desc.num_triangles,
+			desc.texture_size);
+	return name;
+}
+
+// same interface as scene_t::build_scene
+static void build_workload(const workload_t &workload, Model **model, int &model_num, IShader **shader_model,
+	IShader **shader_skybox, mat4 perspective, Camera *camera)
+{
+	if (workload.scene != NULL)
+	{
+		workload.scene->build_scene(model, model_num, shader_model, shader_skybox, perspective, camera);
+		return;
+	}
+
+	PhongShader *shader_phong = new PhongShader();
+	shader_phong->payload.camera_perp_matrix = perspective;
+	shader_phong->payload.camera = camera;
+	model[0] = create_synthetic_model(workload.synthetic);
+	model_num = 1;
+	*shader_model = shader_phong;
+	*shader_skybox = NULL;
+}
+
+/* benchmark */
+// renders the warmup frames and then the measured ones, the path restarts after the warmup
+static void run_benchmark(benchmark_run_t &run, const options_t &options, const std::vector<camera_pose_t> &poses,
+	Model **model, int model_num, IShader *shader_model, IShader *shader_skybox)
+{
+	int width = run.resolution.width, height = run.resolution.height;
+	job_system_shutdown();
+	job_system_init(run.num_threads - 1);
+
+	float aspect = (float)width / height;
+	mat4 perspective_mat = mat4_perspective(60, aspect, -0.1, -10000);
+	Camera camera(Eye, Target, Up, aspect);
+
+	frame_t frame;
+	create_frame(frame, width, height, camera, shader_model, shader_skybox, run.mode);
+	frame.shader_model->payload.camera_perp_matrix = perspective_mat;
+	if (frame.shader_skybox != NULL)
+		frame.shader_skybox->payload.camera_perp_matrix = perspective_mat;
+	frame.framebuffer = (unsigned char *)malloc(sizeof(unsigned char) * width * height * 4);
+
+	for (int i = 0; i < options.num_warmup + options.num_frames; i++)
+	{
+		int index = i < options.num_warmup ? i : i - options.num_warmup;
+		const camera_pose_t &pose = poses[index % poses.size()];
+		camera.eye = pose.eye;
+		camera.target = pose.target;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		prepare_frame(frame, camera, perspective_mat, model, model_num);
+		std::chrono::steady_clock::time_point prepared = std::chrono::steady_clock::now();
+		draw_frame(frame, model, model_num);
+		std::chrono::steady_clock::time_point drawn = std::chrono::steady_clock::now();
+
+		if (i < options.num_warmup)
+			continue;
+		frame_sample_t sample;
+		sample.prepare_ms = elapsed_ms(start, prepared);
+		sample.draw_ms = elapsed_ms(prepared, drawn);
+		sample.visible_models = frame.num_draws;
+		sample.drawn_models = frame.num_drawn;
+		sample.covered_pixels = frame.num_covered;
+		sample.counters = frame.counters;
+		run.samples.push_back(sample);
+	}
+
+	free(frame.framebuffer);
+	destroy_frame(frame);
+}
+
+/* command line */
+static void print_usage()
+{
+	printf(
+		"usage: SRenderBench [options]\n"
+		"  --scenes A,B,...   scenes to run, all of them by default unless --synthetic is given\n"
+		"  --synthetic S:N[:T[:L]],...\n"
+		"                     generated models, S is sphere, grid, overdraw or micro, N the triangles\n"
+		"                     with an optional k or m suffix, T the texture size (1024) and L the\n"
+		"                     layers of overdraw (8)\n"
+		"  --mesh MODE        processing of the synthetic meshes: raw, optimized or lods, optimized by\n"
+		"                     default. flat shapes simplify to a few faces, so lods hides their count\n"
+		"  --sizes WxH,...    resolutions, 800x600 by default\n"
+		"  --threads N,...    threads drawing a frame including the main thread, 1 and all by default\n"
+		"  --draw-modes M,... serial, immediate, pipelined or auto, auto by default\n"
+		"  --frames N         measured frames per run, 120 by default\n"
+		"  --warmup N         frames drawn before measuring, 10 by default\n"
+		"  --path FILE        camera path as for SRender --path, an orbit of the target by default\n"
+		"  --output FILE      json results, benchmark.json by default\n");
+}
+
+// split a comma separated list, return 0 if an element is empty
+static int split_list(const char *text, std::vector<std::string> &items)
+{
+	std::string list(text);
+	size_t begin = 0;
+	for (;;)
+	{
+		size_t end = list.find(',', begin);
+		std::string item = list.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+		if (item.empty())
+			return 0;
+		items.push_back(item);
+		if (end == std::string::npos)
+			return 1;
+		begin = end + 1;
+	}
+}
+
+// SHAPE:TRIANGLES[:TEXTURE[:LAYERS]], return 0 if it is malformed
+static int parse_synthetic(const std::string &item, synthetic_desc_t &desc)
+{
+	char shape_name[32], suffix = 0;
+	double num_triangles;
+	desc.texture_size = 1024;
+	desc.num_layers = 8;
+	desc.mesh_flags = 0;
+
+	const char *text = item.c_str();
+	const char *separator = strchr(text, ':');
+	if (separator == NULL || separator - text >= (int)sizeof(shape_name))
+		return 0;
+	memcpy(shape_name, text, separator - text);
+	shape_name[separator - text] = '\0';
+	int shape = find_synthetic_shape(shape_name);
+	if (shape < 0)
+	{
+		printf("unknown synthetic shape %s\n", shape_name);
+		return 0;
+	}
+	desc.shape = (synthetic_shape)shape;
+
+	// the count may be followed by a k or m suffix and then the optional fields
+	int length = 0;
+	if (sscanf(separator + 1, "%lf%n", &num_triangles, &length) != 1)
+		return 0;
+	const char *rest = separator + 1 + length;
+	if (*rest == 'k' || *rest == 'K' || *rest == 'm' || *rest == 'M')
+		suffix = *rest++;
+	if (suffix == 'k' || suffix == 'K')
+		num_triangles *= 1000;
+	else if (suffix == 'm' || suffix == 'M')
+		num_triangles *= 1000000;
+	desc.num_triangles = (long long)num_triangles;
+
+	if (*rest == ':')
+	{
+		int fields = sscanf(rest, ":%d:%d", &desc.texture_size, &desc.num_layers);
+		if (fields < 1)
+			return 0;
+	}
+	// the index buffer keeps the levels of detail after the full mesh, 32-bit indices bound both
+	return desc.num_triangles >= 1 && desc.num_triangles <= 400000000 && desc.texture_size >= 1 && desc.num_layers >= 1;
+}
+
+static int parse_options(int argc, char **argv, options_t &options)
+{
+	options.num_frames = 120;
+	options.num_warmup = 10;
+	options.path_filename = NULL;
+	options.output_filename = "benchmark.json";
+	options.synthetic_flags = MESH_FLAG_OPTIMIZED;
+
+	int has_scenes = 0, has_synthetic = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (strcmp(arg, "--help") == 0 || value == NULL)
+			return 0;
+
+		std::vector<std::string> items;
+		if (strcmp(arg, "--scenes") == 0)
+		{
+			if (!split_list(value, items))
+				return 0;
+			for (size_t k = 0; k < items.size(); k++)
+			{
+				const scene_t *scene = find_scene(items[k].c_str());
+				if (scene == NULL)
+				{
+					printf("unknown scene %s\n", items[k].c_str());
+					return 0;
+				}
+				workload_t workload;
+				workload.scene = scene;
+				options.workloads.push_back(workload);
+			}
+			has_scenes = 1;
+		}
+		else if (strcmp(arg, "--synthetic") == 0)
+		{
+			if (!split_list(value, items))
+				return 0;
+			for (size_t k = 0; k < items.size(); k++)
+			{
+				workload_t workload;
+				workload.scene = NULL;
+				if (!parse_synthetic(items[k], workload.synthetic))
+					return 0;
+				options.workloads.push_back(workload);
+			}
+			has_synthetic = 1;
+		}
+		else if (strcmp(arg, "--sizes") == 0)
+		{
+			if (!split_list(value, items))
+				return 0;
+			for (size_t k = 0; k < items.size(); k++)
+			{
+				resolution_t resolution;
+				if (sscanf(items[k].c_str(), "%dx%d", &resolution.width, &resolution.height) != 2 ||
+					resolution.width < 2 || resolution.height < 2)
+					return 0;
+				options.resolutions.push_back(resolution);
+			}
+		}
+		else if (strcmp(arg, "--threads") == 0)
+		{
+			if (!split_list(value, items))
+				return 0;
+			for (size_t k = 0; k < items.size(); k++)
+			{
+				int num_threads = atoi(items[k].c_str());
+				if (num_threads <= 0)
+					return 0;
+				options.thread_counts.push_back(num_threads);
+			}
+		}
+		else if (strcmp(arg, "--draw-modes") == 0)
+		{
+			if (!split_list(value, items))
+				return 0;
+			for (size_t k = 0; k < items.size(); k++)
+			{
+				int mode = find_draw_mode(items[k].c_str());
+				if (mode < 0)
+					return 0;
+				options.modes.push_back((draw_mode)mode);
+			}
+		}
+		else if (strcmp(arg, "--mesh") == 0)
+		{
+			if (strcmp(value, "raw") == 0)
+				options.synthetic_flags = 0;
+			else if (strcmp(value, "optimized") == 0)
+				options.synthetic_flags = MESH_FLAG_OPTIMIZED;
+			else if (strcmp(value, "lods") == 0)
+				options.synthetic_flags = MESH_FLAG_OPTIMIZED | MESH_FLAG_LODS;
+			else
+				return 0;
+		}
+		else if (strcmp(arg, "--frames") == 0)
+		{
+			options.num_frames = atoi(value);
+			if (options.num_frames <= 0)
+				return 0;
+		}
+		else if (strcmp(arg, "--warmup") == 0)
+		{
+			options.num_warmup = atoi(value);
+			if (options.num_warmup < 0)
+				return 0;
+		}
+		else if (strcmp(arg, "--path") == 0)
+			options.path_filename = value;
+		else if (strcmp(arg, "--output") == 0)
+			options.output_filename = value;
+		else
+			return 0;
+		i++;
+	}
+
+	if (!has_scenes && !has_synthetic)
+	{
+		for (int i = 0; i < scene_count(); i++)
+		{
+			workload_t workload;
+			workload.scene = scene_at(i);
+			options.workloads.push_back(workload);
+		}
+	}
+	for (size_t i = 0; i < options.workloads.size(); i++)
+	{
+		if (options.workloads[i].scene == NULL)
+			options.workloads[i].synthetic.mesh_flags = options.synthetic_flags;
+	}
+	if (options.resolutions.empty())
+	{
+		resolution_t resolution = { WINDOW_WIDTH, WINDOW_HEIGHT };
+		options.resolutions.push_back(resolution);
+	}
+	if (options.thread_counts.empty())
+	{
+		int hardware_threads = (int)std::thread::hardware_concurrency();
+		options.thread_counts.push_back(1);
+		if (hardware_threads > 1)
+			options.thread_counts.push_back(hardware_threads);
+	}
+	if (options.modes.empty())
+		options.modes.push_back(DRAW_AUTO);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	options_t options;
+	if (!parse_options(argc, argv, options))
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::vector<camera_pose_t> poses;
+	if (options.path_filename != NULL)
+	{
+		if (!load_camera_path(options.path_filename, poses))
+		{
+			printf("can't load the camera path %s\n", options.path_filename);
+			return 1;
+		}
+	}
+	else
+		build_orbit_path(options.num_frames, poses);
+
+	std::vector<benchmark_run_t> runs;
+	for (size_t w = 0; w < options.workloads.size(); w++)
+	{
+		// the workload is built once, every run binds the projection of its resolution to clones of the shaders
+		const workload_t &workload = options.workloads[w];
+		Camera camera(Eye, Target, Up, (float)WINDOW_WIDTH / WINDOW_HEIGHT);
+		mat4 perspective_mat = mat4_perspective(60, (float)WINDOW_WIDTH / WINDOW_HEIGHT, -0.1, -10000);
+		int model_num = 0;
+		Model *model[MAX_MODEL_NUM];
+		IShader *shader_model;
+		IShader *shader_skybox;
+		build_workload(workload, model, model_num, &shader_model, &shader_skybox, perspective_mat, &camera);
+		long long num_triangles = 0;
+		for (int i = 0; i < model_num; i++)
+			num_triangles += model[i]->nfaces();
+
+		for (size_t r = 0; r < options.resolutions.size(); r++)
+		{
+			for (size_t t = 0; t < options.thread_counts.size(); t++)
+			{
+				for (size_t d = 0; d < options.modes.size(); d++)
+				{
+					benchmark_run_t run;
+					run.workload_name = workload_name(workload);
+					run.num_triangles = num_triangles;
+					run.texture_size = workload.scene != NULL ? 0 : workload.synthetic.texture_size;
+					run.resolution = options.resolutions[r];
+					run.num_threads = options.thread_counts[t];
+					run.mode = options.modes[d];
+					run_benchmark(run, options, poses, model, model_num, shader_model, shader_skybox);
+
+					double total_ms = 0;
+					for (size_t i = 0; i < run.samples.size(); i++)
+						total_ms += run.samples[i].prepare_ms + run.samples[i].draw_ms;
+					printf("%-8s %5dx%-5d threads %2d %-9s: %8.3f ms/frame\n", run.workload_name.c_str(), run.resolution.width,
+						run.resolution.height, run.num_threads, draw_mode_name(run.mode), total_ms / run.samples.size());
+					runs.push_back(run);
+				}
+			}
+		}
+
+		for (int i = 0; i < model_num; i++)
+			delete model[i];
+		delete shader_model;
+		delete shader_skybox;
+	}
+	job_system_shutdown();
+
+	FILE *file = fopen(options.output_filename, "w");
+	if (file == NULL)
+	{
+		printf("can't write %s\n", options.output_filename);
+		return 1;
+	}
+	write_json(file, options, runs);
+	fclose(file);
+	printf("results written to %s\n", options.output_filename);
+	return 0;
+}
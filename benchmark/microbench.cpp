@@ -0,0 +1,451 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../core/camera.h"
+#include "../core/jobsystem.h"
+#include "../core/macro.h"
+#include "../core/maths.h"
+#include "../core/model.h"
+#include "../core/pipeline.h"
+#include "../core/sample.h"
+#include "../core/tgaimage.h"
+#include "../platform/platform.h"
+#include "../shader/shader.h"
+
+// isolated timings of the building blocks of the pipeline on synthetic inputs. the benchmark
+// runs on one thread pinned to a cpu, every kernel is repeated until a run takes min_time and
+// the run is repeated, the minimum and median time per element are reported.
+// the input files are written to the temp directory and removed at the end
+
+typedef struct
+{
+	const char *filter;			// only the kernels whose name contains it
+	int num_repetitions;
+	double min_time_ms;
+	int cpu;
+} options_t;
+
+static options_t options;
+
+// results are accumulated here so the compiler can't drop the work of a kernel
+static volatile float sink;
+
+/* timing */
+static double time_calls(const std::function<void()> &body, long long calls)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long long i = 0; i < calls; i++)
+		body();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// one call of body processes num_elements elements of the unit
+static void run_kernel(const char *name, const char *unit, int num_elements, const std::function<void()> &body)
+{
+	if (options.filter != NULL && strstr(name, options.filter) == NULL)
+		return;
+
+	// warm the caches, then double the calls until a run is long enough to time
+	body();
+	long long calls = 1;
+	while (time_calls(body, calls) < options.min_time_ms && calls < (1LL << 40))
+		calls *= 2;
+
+	std::vector<double> ns_per_element;
+	for (int r = 0; r < options.num_repetitions; r++)
+		ns_per_element.push_back(time_calls(body, calls) * 1e6 / ((double)calls * num_elements));
+	std::sort(ns_per_element.begin(), ns_per_element.end());
+
+	printf("%-24s %12.3f %12.3f  ns/%-8s %4d x %lld\n", name, ns_per_element.front(),
+		ns_per_element[ns_per_element.size() / 2], unit, options.num_repetitions, calls);
+}
+
+/* synthetic inputs */
+static float random_float(float min, float max)
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static vec3 random_direction()
+{
+	vec3 v;
+	do
+		v = vec3(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1));
+	while (v.norm() < 0.01f || v.norm() > 1);
+	return unit_vector(v);
+}
+
+// smooth gradients with a checker on top, so the rle encoder finds some runs but not only runs
+static TGAImage *create_texture(int width, int height, int bytespp)
+{
+	TGAImage *image = new TGAImage(width, height, bytespp);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int checker = ((x / 16) + (y / 16)) % 2 ? 64 : 0;
+			TGAColor c((unsigned char)(x * 255 / width), (unsigned char)(y * 255 / height), (unsigned char)(128 + checker));
+			image->set(x, y, c);
+		}
+	}
+	return image;
+}
+
+static cubemap_t *create_cubemap(int size)
+{
+	cubemap_t *cubemap = new cubemap_t();
+	for (int i = 0; i < 6; i++)
+		cubemap->faces[i] = create_texture(size, size, TGAImage::RGB);
+	return cubemap;
+}
+
+static void destroy_cubemap(cubemap_t *cubemap)
+{
+	for (int i = 0; i < 6; i++)
+		delete cubemap->faces[i];
+	delete cubemap;
+}
+
+// uv sphere with normals and uvs, the poles are degenerate quads like in most exported meshes
+static void write_sphere_obj(const char *filename, int rings, int segments)
+{
+	FILE *file = fopen(filename, "w");
+	for (int r = 0; r <= rings; r++)
+	{
+		for (int s = 0; s <= segments; s++)
+		{
+			float theta = PI * r / rings, phi = 2 * PI * s / segments;
+			vec3 n(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			fprintf(file, "v %f %f %f\n", n.x(), n.y(), n.z());
+			fprintf(file, "vt %f %f\n", s / (float)segments, 1 - r / (float)rings);
+			fprintf(file, "vn %f %f %f\n", n.x(), n.y(), n.z());
+		}
+	}
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			int a = r * (segments + 1) + s + 1, b = a + segments + 1;
+			fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, a + 1, a + 1, a + 1);
+			fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+		}
+	}
+	fclose(file);
+}
+
+// a triangle of the model as the rasterizer hands it to the fragment shader
+static void setup_varying(varying_t &varying, Model *model, const mat4 &mvp, int nface)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		int v = model->face(nface)[i];
+		varying.clipcoord_attri[i]	= mvp * to_vec4(model->vert(v), 1.0f);
+		varying.worldcoord_attri[i] = model->vert(v);
+		varying.normal_attri[i]		= model->normal(v);
+		varying.uv_attri[i]			= model->uv(v);
+	}
+}
+
+/* kernels */
+static void bench_maths(const mat4 &mvp)
+{
+	const int count = 1024;
+	std::vector<vec4> points(count);
+	for (int i = 0; i < count; i++)
+		points[i] = vec4(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1), 1);
+
+	run_kernel("mat4_mul_vec4", "vec4", count, [&]()
+	{
+		vec4 sum(0, 0, 0, 0);
+		for (int i = 0; i < count; i++)
+			sum = sum + mvp * points[i];
+		sink = sum.w();
+	});
+}
+
+static void bench_vertex_shader(Model *model, const IShader &shader)
+{
+	int num_verts = model->nverts();
+	std::vector<vertex_out_t> out(num_verts);
+	run_kernel("vertex_shader", "vertex", num_verts, [&]()
+	{
+		for (int i = 0; i < num_verts; i++)
+			shader.vertex_shader(i, out[i]);
+		sink = out[num_verts - 1].clipcoord.w();
+	});
+}
+
+// triangles around the target stay inside, triangles reaching behind the camera and past the
+// sides of the view cross the near and side planes
+static void bench_clipping(const mat4 &mvp)
+{
+	const int count = 1024;
+	std::vector<vec4> inside(count * 3), crossing(count * 3);
+	for (int i = 0; i < count * 3; i++)
+	{
+		inside[i] = mvp * to_vec4(vec3(random_float(-0.5f, 0.5f), random_float(-0.5f, 0.5f), random_float(-0.5f, 0.5f)), 1);
+		vec3 p = i % 3 == 0 ? vec3(random_float(-1, 1), random_float(-1, 1), 4) :
+			vec3(random_float(-4, 4), random_float(-4, 4), random_float(-1, 1));
+		crossing[i] = mvp * to_vec4(p, 1);
+	}
+
+	varying_t varying;
+	for (int i = 0; i < 3; i++)
+	{
+		varying.in_normal[i] = vec3(0, 0, 1);
+		varying.in_uv[i] = vec2(0.5f, 0.5f);
+		varying.in_worldcoord[i] = vec3(0, 0, 0);
+	}
+	const char *names[2] = { "homo_clipping_inside", "homo_clipping_crossing" };
+	const std::vector<vec4> *inputs[2] = { &inside, &crossing };
+	for (int k = 0; k < 2; k++)
+	{
+		const std::vector<vec4> &clipcoords = *inputs[k];
+		run_kernel(names[k], "triangle", count, [&]()
+		{
+			int num_vertex = 0;
+			for (int i = 0; i < count; i++)
+			{
+				for (int j = 0; j < 3; j++)
+					varying.in_clipcoord[j] = clipcoords[i * 3 + j];
+				num_vertex += homo_clipping(varying);
+			}
+			sink = (float)num_vertex;
+		});
+	}
+}
+
+static void bench_coverage()
+{
+	vec3 screen_pos[3] = { vec3(10, 10, 1), vec3(250, 40, 1), vec3(70, 230, 1) };
+	int xmin = 10, xmax = 250, ymin = 10, ymax = 230;
+	int num_pixels = (xmax - xmin + 1) * (ymax - ymin + 1);
+	run_kernel("barycentric_coverage", "pixel", num_pixels, [&]()
+	{
+		int covered = 0;
+		for (int x = xmin; x <= xmax; x++)
+		{
+			for (int y = ymin; y <= ymax; y++)
+			{
+				vec3 barycentric = compute_barycentric2D(x + 0.5f, y + 0.5f, screen_pos);
+				covered += is_inside_triangle(barycentric.x(), barycentric.y(), barycentric.z());
+			}
+		}
+		sink = (float)covered;
+	});
+}
+
+static void bench_sampling(TGAImage *texture, cubemap_t *cubemap)
+{
+	const int count = 4096;
+	std::vector<vec2> uvs(count);
+	std::vector<vec3> directions(count);
+	for (int i = 0; i < count; i++)
+	{
+		uvs[i] = vec2(random_float(0, 1), random_float(0, 1));
+		directions[i] = random_direction();
+	}
+
+	run_kernel("texture_sample", "sample", count, [&]()
+	{
+		vec3 sum(0, 0, 0);
+		for (int i = 0; i < count; i++)
+			sum += texture_sample(uvs[i], texture);
+		sink = sum.x();
+	});
+	run_kernel("cubemap_sampling", "sample", count, [&]()
+	{
+		vec3 sum(0, 0, 0);
+		for (int i = 0; i < count; i++)
+			sum += cubemap_sampling(directions[i], cubemap);
+		sink = sum.x();
+	});
+}
+
+static void bench_fragment_shader(const char *name, const IShader &shader, const varying_t &varying)
+{
+	const int count = 4096;
+	std::vector<vec3> barycentrics(count);
+	for (int i = 0; i < count; i++)
+	{
+		float alpha = random_float(0, 1), beta = random_float(0, 1 - alpha);
+		barycentrics[i] = vec3(alpha, beta, 1 - alpha - beta);
+	}
+
+	run_kernel(name, "fragment", count, [&]()
+	{
+		vec3 sum(0, 0, 0);
+		for (int i = 0; i < count; i++)
+			sum += shader.fragment_shader(varying, barycentrics[i].x(), barycentrics[i].y(), barycentrics[i].z());
+		sink = sum.x();
+	});
+}
+
+static void bench_files(const std::string &directory, const char *obj_filename)
+{
+	std::string raw_filename = directory + "/raw.tga", rle_filename = directory + "/rle.tga";
+	TGAImage *image = create_texture(1024, 1024, TGAImage::RGB);
+	image->write_tga_file(raw_filename.c_str(), false);
+	image->write_tga_file(rle_filename.c_str(), true);
+	delete image;
+
+	const char *names[2] = { "tga_decode_raw", "tga_decode_rle" };
+	const std::string *filenames[2] = { &raw_filename, &rle_filename };
+	for (int k = 0; k < 2; k++)
+	{
+		const char *filename = filenames[k]->c_str();
+		run_kernel(names[k], "pixel", 1024 * 1024, [filename]()
+		{
+			TGAImage decoded;
+			decoded.read_tga_file(filename);
+			sink = decoded.buffer()[0];
+		});
+	}
+
+	std::vector<vec3> positions, normals;
+	std::vector<vec2> texcoords;
+	std::vector<unsigned int> indices;
+	parse_obj(obj_filename, 0, positions, normals, texcoords, indices);
+	run_kernel("obj_parse", "face", (int)indices.size() / 3, [&]()
+	{
+		parse_obj(obj_filename, 0, positions, normals, texcoords, indices);
+		sink = (float)indices.size();
+	});
+}
+
+/* command line */
+static void print_usage()
+{
+	printf(
+		"usage: SRenderMicrobench [options]\n"
+		"  --filter TEXT      only the kernels whose name contains TEXT\n"
+		"  --repetitions N    timed runs of every kernel, 15 by default\n"
+		"  --min-time MS      shortest run, the calls per run are doubled until it is reached, 20 by default\n"
+		"  --cpu N            cpu the benchmark is pinned to, 0 by default\n");
+}
+
+static int parse_options(int argc, char **argv)
+{
+	options.filter = NULL;
+	options.num_repetitions = 15;
+	options.min_time_ms = 20;
+	options.cpu = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (strcmp(arg, "--help") == 0 || value == NULL)
+			return 0;
+
+		if (strcmp(arg, "--filter") == 0)
+			options.filter = value;
+		else if (strcmp(arg, "--repetitions") == 0)
+		{
+			options.num_repetitions = atoi(value);
+			if (options.num_repetitions <= 0)
+				return 0;
+		}
+		else if (strcmp(arg, "--min-time") == 0)
+		{
+			options.min_time_ms = atof(value);
+			if (options.min_time_ms <= 0)
+				return 0;
+		}
+		else if (strcmp(arg, "--cpu") == 0)
+			options.cpu = atoi(value);
+		else
+			return 0;
+		i++;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+	{
+		print_usage();
+		return 1;
+	}
+
+	// every kernel runs on this thread, loading the model doesn't start workers either
+	if (!platform_pin_thread(options.cpu))
+		printf("can't pin the benchmark to cpu %d, timings may be noisy\n", options.cpu);
+	job_system_init(0);
+	srand(1);
+
+	std::filesystem::path temp_directory = std::filesystem::temp_directory_path() / "srender_microbench";
+	std::filesystem::create_directories(temp_directory);
+	std::string directory = temp_directory.string();
+	std::string obj_filename = directory + "/sphere.obj";
+	write_sphere_obj(obj_filename.c_str(), 128, 256);
+
+	// a textured sphere in front of the camera, the maps are owned and freed by the model
+	Model *model = new Model(obj_filename.c_str());
+	model->diffusemap		= create_texture(1024, 1024, TGAImage::RGB);
+	model->normalmap		= create_texture(1024, 1024, TGAImage::RGB);
+	model->roughnessmap		= create_texture(512, 512, TGAImage::RGB);
+	model->metalnessmap		= create_texture(512, 512, TGAImage::RGB);
+	model->occlusion_map	= create_texture(512, 512, TGAImage::RGB);
+	model->environment_map	= create_cubemap(512);
+
+	iblmap_t iblmap;
+	iblmap.mip_levels = 8;
+	iblmap.irradiance_map = create_cubemap(32);
+	for (int i = 0; i < iblmap.mip_levels; i++)
+		iblmap.prefilter_maps[i] = create_cubemap(std::max(256 >> i, 1));
+	iblmap.brdf_lut = create_texture(256, 256, TGAImage::RGB);
+
+	Camera camera(vec3(0, 0, 3), vec3(0, 0, 0), vec3(0, 1, 0), (float)WINDOW_WIDTH / WINDOW_HEIGHT);
+	mat4 perspective = mat4_perspective(60, (float)WINDOW_WIDTH / WINDOW_HEIGHT, -0.1, -10000);
+	mat4 mvp = perspective * mat4_lookat(camera.eye, camera.target, camera.up);
+
+	PhongShader phong;
+	PBRShader pbr;
+	SkyboxShader skybox;
+	IShader *shaders[3] = { &phong, &pbr, &skybox };
+	for (int i = 0; i < 3; i++)
+	{
+		payload_t &payload = shaders[i]->payload;
+		payload.camera_perp_matrix = perspective;
+		payload.camera_view_matrix = mat4_lookat(camera.eye, camera.target, camera.up);
+		payload.mvp_matrix = mvp;
+		payload.camera = &camera;
+		payload.model = model;
+		payload.iblmap = &iblmap;
+	}
+
+	// a face on the front of the sphere
+	varying_t varying;
+	setup_varying(varying, model, mvp, model->nfaces() / 2 + 128);
+
+	printf("%-24s %12s %12s\n", "kernel", "min", "median");
+	bench_maths(mvp);
+	bench_vertex_shader(model, phong);
+	bench_clipping(mvp);
+	bench_coverage();
+	bench_sampling(model->diffusemap, model->environment_map);
+	bench_fragment_shader("fragment_shader_phong", phong, varying);
+	bench_fragment_shader("fragment_shader_pbr", pbr, varying);
+	bench_fragment_shader("fragment_shader_skybox", skybox, varying);
+	bench_files(directory, obj_filename.c_str());
+
+	delete model;
+	destroy_cubemap(iblmap.irradiance_map);
+	for (int i = 0; i < iblmap.mip_levels; i++)
+		destroy_cubemap(iblmap.prefilter_maps[i]);
+	delete iblmap.brdf_lut;
+	std::filesystem::remove_all(temp_directory);
+	job_system_shutdown();
+	return 0;
+}
@@ -1,6 +1,8 @@
 #include "./camera.h"
 
-#include "../platform/win32.h"
+#include <cstdio>
+
+#include "../platform/platform.h"
 
 Camera::Camera(vec3 e, vec3 t, vec3 up, float aspect):
 	eye(e),target(t),up(up),aspect(aspect)
@@ -75,27 +77,27 @@ void handle_key_events(Camera& camera)
 	{
 		camera.eye += 0.05f*camera.z;
 	}
-	if (window->keys[VK_UP] || window->keys['Q'])
+	if (window->keys[KEY_UP] || window->keys['Q'])
 	{
 		camera.eye += 0.05f*camera.y;
 		camera.target += 0.05f*camera.y;
 	}
-	if (window->keys[VK_DOWN] || window->keys['E'])
+	if (window->keys[KEY_DOWN] || window->keys['E'])
 	{
 		camera.eye += -0.05f*camera.y;
 		camera.target += -0.05f*camera.y;
 	}
-	if (window->keys[VK_LEFT] || window->keys['A'])
+	if (window->keys[KEY_LEFT] || window->keys['A'])
 	{
 		camera.eye += -0.05f*camera.x;
 		camera.target += -0.05f*camera.x;
 	}
-	if (window->keys[VK_RIGHT] || window->keys['D'])
+	if (window->keys[KEY_RIGHT] || window->keys['D'])
 	{
 		camera.eye += 0.05f*camera.x;
 		camera.target += 0.05f*camera.x;
 	}
-	if (window->keys[VK_ESCAPE])
+	if (window->keys[KEY_ESCAPE])
 	{
 		window->is_close = 1;
 	}
@@ -111,4 +113,23 @@ void handle_events(Camera& camera)
 	//mouse and keyboard events
 	handle_mouse_events(camera);
 	handle_key_events(camera);
-}
\ No newline at end of file
+}
+
+int load_camera_path(const char *filename, std::vector<camera_pose_t> &poses)
+{
+	FILE *file = fopen(filename, "r");
+	if (file == NULL)
+		return 0;
+
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		float v[6];
+		if (sscanf(line, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6)
+			continue;
+		camera_pose_t pose = { vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]) };
+		poses.push_back(pose);
+	}
+	fclose(file);
+	return !poses.empty();
+}
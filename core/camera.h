@@ -1,4 +1,6 @@
 #pragma once
+#include <vector>
+
 #include "./maths.h"
 
 class Camera
@@ -14,8 +16,22 @@ public:
 	vec3 y;
 	vec3 z;
 	float aspect;
+
+	//view frustum planes in world space, updated together with the view matrix
+	vec4 frustum[6];
 };
 
 //handle event
 void updata_camera_pos(Camera& camera);
-void handle_events(Camera& camera);
\ No newline at end of file
+void handle_events(Camera& camera);
+
+//one pose of a recorded camera path
+typedef struct
+{
+	vec3 eye;
+	vec3 target;
+} camera_pose_t;
+
+//text file with one "eye_x eye_y eye_z target_x target_y target_z" per line, return 0 if
+//the file can't be read or has no pose
+int load_camera_path(const char *filename, std::vector<camera_pose_t> &poses);
@@ -0,0 +1,107 @@
+#include "./filemap.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+mapped_file_t *map_file(const char *filename)
+{
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapped_file_t *mapped = (mapped_file_t *)malloc(sizeof(mapped_file_t));
+	memset(mapped, 0, sizeof(mapped_file_t));
+	mapped->size = (size_t)size.QuadPart;
+	mapped->file_handle = file;
+	mapped->fd = -1;
+
+	// an empty file can not be mapped, but it is still a valid (empty) input
+	if (mapped->size == 0)
+		return mapped;
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		unmap_file(mapped);
+		return NULL;
+	}
+	mapped->map_handle = mapping;
+	mapped->data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped->data == NULL)
+	{
+		unmap_file(mapped);
+		return NULL;
+	}
+	return mapped;
+}
+
+void unmap_file(mapped_file_t *file)
+{
+	if (file == NULL)
+		return;
+	if (file->data) UnmapViewOfFile(file->data);
+	if (file->map_handle) CloseHandle((HANDLE)file->map_handle);
+	if (file->file_handle) CloseHandle((HANDLE)file->file_handle);
+	free(file);
+}
+#else
+mapped_file_t *map_file(const char *filename)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	mapped_file_t *mapped = (mapped_file_t *)malloc(sizeof(mapped_file_t));
+	memset(mapped, 0, sizeof(mapped_file_t));
+	mapped->size = (size_t)st.st_size;
+	mapped->fd = fd;
+
+	// an empty file can not be mapped, but it is still a valid (empty) input
+	if (mapped->size == 0)
+		return mapped;
+
+	void *data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		unmap_file(mapped);
+		return NULL;
+	}
+	madvise(data, mapped->size, MADV_SEQUENTIAL);
+	mapped->data = (const char *)data;
+	return mapped;
+}
+
+void unmap_file(mapped_file_t *file)
+{
+	if (file == NULL)
+		return;
+	if (file->data) munmap((void *)file->data, file->size);
+	if (file->fd >= 0) close(file->fd);
+	free(file);
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+
+// read-only memory mapping of a whole file, used by the model loader
+typedef struct
+{
+	const char *data;
+	size_t size;
+
+	// native handles
+	void *file_handle;
+	void *map_handle;
+	int fd;
+} mapped_file_t;
+
+mapped_file_t *map_file(const char *filename);
+void unmap_file(mapped_file_t *file);
@@ -0,0 +1,215 @@
+#include "./frame.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "./trace.h"
+
+static const char *DRAW_MODE_NAMES[DRAW_MODE_NUM] = { "serial", "immediate", "pipelined", "auto" };
+
+// DRAW_AUTO draws a model in immediate mode if the level of detail it is drawn with has fewer
+// faces, binning so few triangles for the raster workers costs more than it saves
+static const int AUTO_IMMEDIATE_FACES = 20000;
+
+const char *draw_mode_name(draw_mode mode)
+{
+	return DRAW_MODE_NAMES[mode];
+}
+
+int find_draw_mode(const char *name)
+{
+	for (int i = 0; i < DRAW_MODE_NUM; i++)
+	{
+		if (strcmp(DRAW_MODE_NAMES[i], name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+void create_frame(frame_t &frame, int width, int height, Camera &camera, IShader *shader_model, IShader *shader_skybox,
+	draw_mode mode)
+{
+	frame.camera		= new Camera(camera);
+	frame.shader_model	= shader_model->clone();
+	frame.shader_skybox = shader_skybox != NULL ? shader_skybox->clone() : NULL;
+	frame.context		= create_draw_context(width, height);
+	frame.zbuffer		= (float *)malloc(sizeof(float) * width * height);
+	frame.framebuffer	= NULL;
+	frame.occlusion		= new occlusion_buffer_t;
+	frame.packed_buffer = mode != DRAW_SERIAL ? new packed_pixel_t[width * height] : NULL;
+	frame.width = width;
+	frame.height = height;
+	frame.mode = mode;
+	frame.num_draws = 0;
+	frame.num_drawn = 0;
+	frame.counters = draw_counters_t();
+	frame.num_covered = 0;
+}
+
+void destroy_frame(frame_t &frame)
+{
+	delete frame.camera;
+	delete frame.shader_model;
+	delete frame.shader_skybox;
+	destroy_draw_context(frame.context);
+	free(frame.zbuffer);
+	delete frame.occlusion;
+	delete[] frame.packed_buffer;
+}
+
+void prepare_frame(frame_t &frame, Camera &camera, mat4 perspective_mat, Model **model, int model_num)
+{
+	TRACE_SCOPE("prepare_frame");
+	int width = frame.width, height = frame.height;
+
+	// clear buffer
+	clear_framebuffer(width, height, frame.framebuffer);
+	clear_zbuffer(width, height, frame.zbuffer);
+	if (frame.packed_buffer != NULL)
+		clear_packed_buffer(width, height, frame.packed_buffer);
+	reset_draw_counters(frame.context);
+
+	// update view matrix
+	*frame.camera = camera;
+	update_matrix(frame, perspective_mat);
+
+	// skip models outside of the view frustum, the skybox is drawn by the sky pass
+	int visible[MAX_MODEL_NUM];
+	for (int m = 0; m < model_num; m++)
+		visible[m] = !model[m]->is_skybox && is_model_visible(model[m], *frame.camera);
+
+	// draw the occluders of the visible models into the occlusion buffer
+	const mat4 &mvp = frame.mvp_matrix;
+	{
+		TRACE_SCOPE("draw_occluders");
+		occlusion_clear(frame.occlusion);
+		for (int m = 0; m < model_num; m++)
+		{
+			if (visible[m])
+				occlusion_draw_occluders(frame.occlusion, model[m], mvp);
+		}
+	}
+
+	// opaque models front to back so near ones fill the zbuffer first
+	float depth[MAX_MODEL_NUM];
+	frame.num_draws = 0;
+	for (int m = 0; m < model_num; m++)
+	{
+		if (!visible[m])
+			continue;
+		depth[m] = sphere_view_depth(mvp, model[m]->bsphere_center, model[m]->bsphere_radius);
+		frame.order[frame.num_draws++] = m;
+	}
+	std::sort(frame.order, frame.order + frame.num_draws, [&depth](int a, int b) { return depth[a] < depth[b]; });
+}
+
+void draw_frame(frame_t &frame, Model **model, int model_num)
+{
+	TRACE_SCOPE("draw_frame");
+	IShader *shader_model = frame.shader_model;
+	IShader *shader_skybox = frame.shader_skybox;
+	shader_model->payload.camera = frame.camera;
+	shader_model->payload.camera_view_matrix = frame.view_matrix;
+	shader_model->payload.mvp_matrix = frame.mvp_matrix;
+
+	// draw models
+	frame.num_drawn = 0;
+	for (int i = 0; i < frame.num_draws; i++)
+	{
+		int m = frame.order[i];
+
+		// skip models hidden behind the occluders
+		if (!occlusion_test_aabb(frame.occlusion, frame.mvp_matrix, model[m]->bbox_min, model[m]->bbox_max))
+			continue;
+		frame.num_drawn++;
+		TRACE_SCOPE("draw_model");
+
+		// assign model data to shader
+		shader_model->payload.model = model[m];
+		draw_mode mode = frame.mode;
+		if (frame.packed_buffer == NULL)
+			mode = DRAW_SERIAL;
+		else if (mode == DRAW_AUTO)
+			mode = lod_face_count(frame.context, *shader_model) < AUTO_IMMEDIATE_FACES ? DRAW_IMMEDIATE : DRAW_PIPELINED;
+
+		if (mode == DRAW_SERIAL)
+			draw_model(frame.context, frame.framebuffer, frame.zbuffer, *shader_model, frame.occlusion);
+		else if (mode == DRAW_IMMEDIATE)
+			draw_model_immediate(frame.context, frame.packed_buffer, *shader_model, frame.occlusion);
+		else
+			draw_model_pipelined(frame.context, frame.packed_buffer, *shader_model, frame.occlusion);
+	}
+	if (frame.packed_buffer != NULL)
+		resolve_packed_buffer(frame.width, frame.height, frame.packed_buffer, frame.framebuffer, frame.zbuffer);
+	frame.counters = draw_context_counters(frame.context);
+	frame.num_covered = count_covered_pixels(frame.width, frame.height, frame.zbuffer);
+
+	// draw the sky into the pixels no model covered
+	for (int m = 0; m < model_num; m++)
+	{
+		if (model[m]->is_skybox && shader_skybox != NULL)
+		{
+			shader_skybox->payload.camera = frame.camera;
+			shader_skybox->payload.camera_view_matrix = frame.skybox_view_matrix;
+			shader_skybox->payload.mvp_matrix = frame.skybox_mvp_matrix;
+			shader_skybox->payload.model = model[m];
+			TRACE_SCOPE("draw_sky");
+			draw_sky(frame.width, frame.height, frame.framebuffer, frame.zbuffer, *shader_skybox);
+		}
+	}
+}
+
+void clear_zbuffer(int width, int height, float* zbuffer)
+{
+	TRACE_SCOPE("clear_zbuffer");
+	for (int i = 0; i < width*height; i++)
+		zbuffer[i] = ZBUFFER_FAR;
+}
+
+void clear_framebuffer(int width, int height, unsigned char* framebuffer)
+{
+	TRACE_SCOPE("clear_framebuffer");
+	for (int i = 0; i < height; i++)
+	{
+		for (int j = 0; j < width; j++)
+		{
+			int index = (i * width + j) * 4;
+
+			framebuffer[index + 2] = 80;
+			framebuffer[index + 1] = 56;
+			framebuffer[index] = 56;
+		}
+	}
+}
+
+int count_covered_pixels(int width, int height, const float *zbuffer)
+{
+	int num_covered = 0;
+	for (int i = 0; i < width * height; i++)
+		num_covered += zbuffer[i] < ZBUFFER_FAR;
+	return num_covered;
+}
+
+void update_matrix(frame_t &frame, mat4 perspective_mat)
+{
+	TRACE_SCOPE("update_matrix");
+	Camera &camera = *frame.camera;
+	frame.view_matrix = mat4_lookat(camera.eye, camera.target, camera.up);
+	frame.mvp_matrix = perspective_mat * frame.view_matrix;
+	frustum_planes(frame.mvp_matrix, camera.frustum);
+
+	mat4 view_skybox = frame.view_matrix;
+	view_skybox[0][3] = 0;
+	view_skybox[1][3] = 0;
+	view_skybox[2][3] = 0;
+	frame.skybox_view_matrix = view_skybox;
+	frame.skybox_mvp_matrix = perspective_mat * view_skybox;
+}
+
+int is_model_visible(Model *model, Camera &camera)
+{
+	if (sphere_outside_frustum(camera.frustum, model->bsphere_center, model->bsphere_radius))
+		return 0;
+	return !aabb_outside_frustum(camera.frustum, model->bbox_min, model->bbox_max);
+}
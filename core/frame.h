@@ -0,0 +1,68 @@
+#pragma once
+#include "./camera.h"
+#include "./macro.h"
+#include "./maths.h"
+#include "./model.h"
+#include "./occlusion.h"
+#include "./pipeline.h"
+#include "../shader/shader.h"
+
+// how draw_frame draws the models, it can change from one frame to the next
+typedef enum
+{
+	DRAW_SERIAL,			// the calling thread rasterizes into the framebuffer and zbuffer
+	DRAW_IMMEDIATE,			// all threads rasterize disjoint face ranges into a packed depth+color buffer
+	DRAW_PIPELINED,			// geometry and raster threads connected by triangle queues, packed buffer
+	DRAW_AUTO,				// immediate for models with few faces, where binning is overkill, pipelined otherwise
+	DRAW_MODE_NUM
+} draw_mode;
+
+const char *draw_mode_name(draw_mode mode);
+// return -1 if there is no mode of that name
+int find_draw_mode(const char *name);
+
+// everything one frame reads and writes. the render loop keeps two of them, so the next frame is
+// prepared on the main thread while the previous one is still drawn by the workers.
+// the frame-parallel batch mode has one per frame in flight
+typedef struct
+{
+	Camera *camera;					// snapshot of the camera when the frame was prepared
+	IShader *shader_model;			// clones of the scene shaders bound to this frame
+	IShader *shader_skybox;
+	draw_context_t *context;
+	mat4 view_matrix;
+	mat4 mvp_matrix;
+	mat4 skybox_view_matrix;
+	mat4 skybox_mvp_matrix;
+
+	float *zbuffer;
+	unsigned char *framebuffer;		// set by the caller before the frame is prepared, e.g. from the presenter
+	packed_pixel_t *packed_buffer;	// NULL if the frame was created for DRAW_SERIAL
+	occlusion_buffer_t *occlusion;
+
+	int width;
+	int height;
+	draw_mode mode;					// read by every draw_frame, a frame created for DRAW_SERIAL stays serial
+	int order[MAX_MODEL_NUM];		// visible models front to back
+	int num_draws;
+	int num_drawn;					// visible models that passed the occlusion test
+	draw_counters_t counters;		// what the pipeline did in the last draw_frame
+	int num_covered;				// pixels covered by a model in the last draw_frame
+} frame_t;
+
+// the frame owns clones of the shaders and a draw context. the packed buffer of the threaded
+// modes is only allocated if mode is not DRAW_SERIAL
+void create_frame(frame_t &frame, int width, int height, Camera &camera, IShader *shader_model, IShader *shader_skybox,
+	draw_mode mode);
+void destroy_frame(frame_t &frame);
+// everything before shading: clear the buffers, take the camera and cull and sort the models
+void prepare_frame(frame_t &frame, Camera &camera, mat4 perspective_mat, Model **model, int model_num);
+// shading of a prepared frame with the shaders of the frame, the counters of the draws are
+// added up into frame.counters at the end
+void draw_frame(frame_t &frame, Model **model, int model_num);
+
+void clear_zbuffer(int width, int height, float* zbuffer);
+void clear_framebuffer(int width, int height, unsigned char* framebuffer);
+int count_covered_pixels(int width, int height, const float *zbuffer);
+void update_matrix(frame_t &frame, mat4 perspective_mat);
+int is_model_visible(Model *model, Camera &camera);
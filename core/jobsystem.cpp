@@ -0,0 +1,211 @@
+#include "./jobsystem.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./spainlock.hpp"
+#include "./trace.h"
+
+typedef struct
+{
+	std::function<void()> func;
+	job_group_t *group;
+} job_t;
+
+typedef struct
+{
+	SpinLock lock;
+	std::deque<job_t> jobs;
+} job_queue_t;
+
+// queue 0 is shared by the threads outside the pool, queue i belongs to worker i
+static job_queue_t *queues = NULL;
+static int num_queues = 0;
+static std::vector<std::thread> workers;
+static std::mutex init_mutex;
+static bool exit_registered = false;
+static thread_local int thread_index = 0;
+
+// idle workers sleep until a job is queued
+static std::atomic<int> queued_jobs(0);
+static std::atomic<int> sleeping_workers(0);
+static std::atomic<bool> running(false);
+static std::mutex sleep_mutex;
+static std::condition_variable wake_up;
+
+static bool pop_job(int index, job_t &job)
+{
+	if (queued_jobs.load() == 0)
+		return false;
+
+	// the newest job of the own queue first, its data is most likely still in cache,
+	// then the oldest job of the others, which usually stands for the largest piece of work
+	for (int i = 0; i < num_queues; i++)
+	{
+		job_queue_t &queue = queues[(index + i) % num_queues];
+		queue.lock.lock();
+		if (!queue.jobs.empty())
+		{
+			if (i == 0)
+			{
+				job = std::move(queue.jobs.back());
+				queue.jobs.pop_back();
+			}
+			else
+			{
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+			}
+			queue.lock.unlock();
+			queued_jobs--;
+			return true;
+		}
+		queue.lock.unlock();
+	}
+	return false;
+}
+
+static void run_job(job_t &job)
+{
+	job.func();
+	job.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+static void worker_main(int index)
+{
+	thread_index = index;
+	char name[32];
+	snprintf(name, sizeof(name), "worker %d", index);
+	trace_thread_name(name);
+	while (running.load())
+	{
+		job_t job;
+		if (pop_job(index, job))
+		{
+			run_job(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleeping_workers++;
+		wake_up.wait(lock, []() { return queued_jobs.load() > 0 || !running.load(); });
+		sleeping_workers--;
+	}
+}
+
+void job_system_init(int num_workers)
+{
+	std::lock_guard<std::mutex> guard(init_mutex);
+	if (queues != NULL)
+		return;
+
+	if (num_workers < 0)
+		num_workers = (int)std::thread::hardware_concurrency() - 1;
+	if (num_workers < 0)
+		num_workers = 0;
+
+	// the workers must be joined before the statics they wait on are destroyed
+	if (!exit_registered)
+	{
+		std::atexit(job_system_shutdown);
+		exit_registered = true;
+	}
+
+	num_queues = num_workers + 1;
+	queues = new job_queue_t[num_queues];
+	running = true;
+	for (int i = 1; i <= num_workers; i++)
+		workers.push_back(std::thread(worker_main, i));
+}
+
+void job_system_shutdown()
+{
+	std::lock_guard<std::mutex> guard(init_mutex);
+	if (queues == NULL)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		running = false;
+	}
+	wake_up.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	delete[] queues;
+	queues = NULL;
+	num_queues = 0;
+}
+
+int job_system_num_threads()
+{
+	if (queues == NULL)
+		job_system_init(-1);
+	return num_queues;
+}
+
+int job_thread_index()
+{
+	return thread_index;
+}
+
+void job_submit(job_group_t &group, const std::function<void()> &job)
+{
+	if (queues == NULL)
+		job_system_init(-1);
+
+	group.pending++;
+	job_t item = { job, &group };
+	job_queue_t &queue = queues[thread_index];
+	queue.lock.lock();
+	queue.jobs.push_back(std::move(item));
+	queue.lock.unlock();
+
+	// a worker going to sleep checks queued_jobs after announcing itself, so either it
+	// sees the new job or it is counted here and gets woken up
+	queued_jobs++;
+	if (sleeping_workers.load() > 0)
+	{
+		{ std::lock_guard<std::mutex> lock(sleep_mutex); }
+		wake_up.notify_one();
+	}
+}
+
+void job_wait(job_group_t &group)
+{
+	// help with any job instead of blocking, which also makes nested waits safe
+	while (group.pending.load(std::memory_order_acquire) > 0)
+	{
+		job_t job;
+		if (pop_job(thread_index, job))
+			run_job(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void parallel_for(int begin, int end, int grain, const std::function<void(int begin, int end)> &body)
+{
+	if (grain < 1)
+		grain = 1;
+	if (end - begin <= grain || job_system_num_threads() == 1)
+	{
+		if (end > begin)
+			body(begin, end);
+		return;
+	}
+
+	job_group_t group;
+	for (int start = begin; start < end; start += grain)
+	{
+		int stop = end - start > grain ? start + grain : end;
+		job_submit(group, [&body, start, stop]() { body(start, stop); });
+	}
+	job_wait(group);
+}
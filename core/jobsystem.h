@@ -0,0 +1,30 @@
+#pragma once
+#include <atomic>
+#include <functional>
+
+// persistent work-stealing thread pool. every worker owns a deque: it pushes and pops
+// its own jobs at the back and steals the oldest jobs from the front of the others.
+// threads outside the pool share one more deque, and help running jobs while they wait
+
+// jobs submitted to a group can be waited on together
+typedef struct
+{
+	std::atomic<int> pending{ 0 };
+} job_group_t;
+
+// num_workers < 0 uses one worker per hardware thread besides the calling one, 0 runs every
+// job on the threads that wait for it.
+// optional, the pool is started with the default size on first use
+void job_system_init(int num_workers);
+void job_system_shutdown();
+
+// workers plus the thread outside the pool
+int job_system_num_threads();
+// 0 for threads outside the pool, 1 ~ num_workers for the workers
+int job_thread_index();
+
+void job_submit(job_group_t &group, const std::function<void()> &job);
+void job_wait(job_group_t &group);
+
+// run body over [begin, end) in ranges of at most grain elements and wait for all of them
+void parallel_for(int begin, int end, int grain, const std::function<void(int begin, int end)> &body);
@@ -3,4 +3,9 @@
 #define MAX_MODEL_NUM 10
 #define MAX_VERTEX 10
 #define EPSILON 1e-5f
-#define EPSILON2 1e-5f
\ No newline at end of file
+#define EPSILON2 1e-5f
+#define USE_MESH_CACHE 1
+#define MESH_OPTIMIZE 1
+#define MESH_LOD 1
+// scoped timing markers recorded for --trace, 0 compiles them out
+#define USE_TRACE 1
\ No newline at end of file
@@ -597,3 +597,60 @@ vec4 vec4_lerp(vec4& start, vec4& end, float alpha)
 {
 	return start + (end - start) * alpha;
 }
+
+/*
+ * extract the clipping planes of a (model-)view-projection matrix, in model space.
+ * in my implementation w is negative for visible points, so a clip coordinate is
+ * inside when x >= w, x <= -w, y >= w, y <= -w, z >= w and z <= -w,
+ * see is_inside_plane() in pipeline.cpp
+ */
+void frustum_planes(const mat4 &m, vec4 planes[6])
+{
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			planes[i * 2][j]	 = m[i][j] - m[3][j];
+			planes[i * 2 + 1][j] = -m[i][j] - m[3][j];
+		}
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = vec3(planes[i][0], planes[i][1], planes[i][2]).norm();
+		if (length > 0)
+			planes[i] /= length;
+	}
+}
+
+int sphere_outside_frustum(const vec4 planes[6], const vec3 &center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		float distance = planes[i][0] * center[0] + planes[i][1] * center[1] + planes[i][2] * center[2] + planes[i][3];
+		if (distance < -radius)
+			return 1;
+	}
+	return 0;
+}
+
+int aabb_outside_frustum(const vec4 planes[6], const vec3 &bbox_min, const vec3 &bbox_max)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// the corner furthest along the plane normal
+		float distance = planes[i][3];
+		for (int j = 0; j < 3; j++)
+			distance += planes[i][j] * (planes[i][j] > 0 ? bbox_max[j] : bbox_min[j]);
+		if (distance < 0)
+			return 1;
+	}
+	return 0;
+}
+
+float sphere_view_depth(const mat4 &m, const vec3 &center, float radius)
+{
+	// visible points have a negative w, which is the view space z
+	float w = m[3][0] * center[0] + m[3][1] * center[1] + m[3][2] * center[2] + m[3][3];
+	return -w - radius;
+}
@@ -146,6 +146,14 @@ mat4 mat4_lookat(vec3 eye, vec3 target, vec3 up);
 mat4 mat4_ortho(float left, float right, float bottom, float top, float near, float far);
 mat4 mat4_perspective(float fovy, float aspect, float near, float far);
 
+/* frustum related functions */
+// the planes point inside, p is inside a plane if dot(plane.xyz, p) + plane.w >= 0
+void frustum_planes(const mat4 &m, vec4 planes[6]);
+int sphere_outside_frustum(const vec4 planes[6], const vec3 &center, float radius);
+int aabb_outside_frustum(const vec4 planes[6], const vec3 &bbox_min, const vec3 &bbox_max);
+// distance from the camera plane to the nearest point of the sphere, m is the mvp matrix
+float sphere_view_depth(const mat4 &m, const vec3 &center, float radius);
+
 /* untility functions */
 float float_max(float a, float b);
 float float_min(float a, float b);
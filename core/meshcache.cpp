@@ -0,0 +1,118 @@
+#include "./meshcache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <process.h>
+#define get_process_id _getpid
+#else
+#include <unistd.h>
+#define get_process_id getpid
+#endif
+
+static const unsigned long long SECTION_ALIGNMENT = 16;
+
+std::string mesh_cache_path(const char *obj_filename)
+{
+	std::string path(obj_filename);
+	size_t dot = path.find_last_of(".");
+	if (dot != std::string::npos)
+		path = path.substr(0, dot);
+	return path + ".mesh";
+}
+
+void mesh_cache_init_header(mesh_cache_header_t &header, const char *obj_filename, unsigned int flags)
+{
+	memset(&header, 0, sizeof(mesh_cache_header_t));
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.flags = flags;
+
+	std::error_code ec;
+	std::filesystem::path source(obj_filename);
+	header.source_size = (unsigned long long)std::filesystem::file_size(source, ec);
+	if (ec) header.source_size = 0;
+	auto time = std::filesystem::last_write_time(source, ec);
+	header.source_time = ec ? 0 : (long long)time.time_since_epoch().count();
+}
+
+mapped_file_t *mesh_cache_open(const char *cache_filename, const mesh_cache_header_t &expected)
+{
+	mapped_file_t *file = map_file(cache_filename);
+	if (file == NULL)
+		return NULL;
+
+	const mesh_cache_header_t *header = (const mesh_cache_header_t *)file->data;
+	bool valid = file->size >= sizeof(mesh_cache_header_t)
+		&& header->magic == MESH_CACHE_MAGIC
+		&& header->version == MESH_CACHE_VERSION
+		&& header->flags == expected.flags
+		&& header->source_size == expected.source_size
+		&& header->source_time == expected.source_time;
+
+	for (int i = 0; valid && i < MESH_SECTION_NUM; i++)
+	{
+		const mesh_section_t &section = header->sections[i];
+		if (section.offset % SECTION_ALIGNMENT != 0 || section.offset > file->size
+			|| section.size > file->size - section.offset)
+			valid = false;
+	}
+
+	if (!valid)
+	{
+		unmap_file(file);
+		return NULL;
+	}
+	return file;
+}
+
+const void *mesh_cache_section(const mapped_file_t *file, mesh_section section)
+{
+	const mesh_cache_header_t *header = (const mesh_cache_header_t *)file->data;
+	return file->data + header->sections[section].offset;
+}
+
+bool mesh_cache_write(const char *cache_filename, mesh_cache_header_t &header, const void *const *section_data)
+{
+	unsigned long long offset = sizeof(mesh_cache_header_t);
+	for (int i = 0; i < MESH_SECTION_NUM; i++)
+	{
+		offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		header.sections[i].offset = offset;
+		offset += header.sections[i].size;
+	}
+
+	// write to a temporary file first, so concurrent processes never map a half-written cache
+	std::string temp_filename = std::string(cache_filename) + ".tmp" + std::to_string(get_process_id());
+	std::ofstream out(temp_filename, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	static const char padding[SECTION_ALIGNMENT] = { 0 };
+	unsigned long long written = sizeof(mesh_cache_header_t);
+	out.write((const char *)&header, sizeof(mesh_cache_header_t));
+	for (int i = 0; i < MESH_SECTION_NUM; i++)
+	{
+		out.write(padding, (std::streamsize)(header.sections[i].offset - written));
+		out.write((const char *)section_data[i], (std::streamsize)header.sections[i].size);
+		written = header.sections[i].offset + header.sections[i].size;
+	}
+	out.close();
+
+	std::error_code ec;
+	if (out.fail())
+	{
+		std::filesystem::remove(temp_filename, ec);
+		return false;
+	}
+	std::filesystem::rename(temp_filename, cache_filename, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp_filename, ec);
+		return false;
+	}
+	return true;
+}
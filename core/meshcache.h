@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+
+#include "./filemap.h"
+
+// binary mesh cache, written next to the obj file the first time it is loaded and
+// memory mapped on later runs. every array lives in its own 16-byte aligned section
+// so the model can point into the mapping directly without parsing or copying.
+#define MESH_CACHE_MAGIC	0x434d5253	// "SRMC"
+#define MESH_CACHE_VERSION	6
+
+// load options baked into the cached data
+#define MESH_FLAG_MMD		1	// flipped uv of mmd models
+#define MESH_FLAG_OPTIMIZED	2	// faces reordered for vertex cache and overdraw
+#define MESH_FLAG_LODS		4	// simplified levels of detail
+
+typedef enum
+{
+	MESH_SECTION_VERTS,
+	MESH_SECTION_NORMS,
+	MESH_SECTION_UVS,
+	MESH_SECTION_INDICES,
+	MESH_SECTION_MESHLETS,
+	MESH_SECTION_OCCLUDERS,
+	MESH_SECTION_LODS,
+	MESH_SECTION_NUM
+} mesh_section;
+
+typedef struct
+{
+	unsigned long long offset;
+	unsigned long long size;
+} mesh_section_t;
+
+typedef struct
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int flags;				// MESH_FLAG_XXX
+	unsigned int reserved;
+
+	// stamp of the source obj file, the cache is rebuilt whenever it changes
+	unsigned long long source_size;
+	long long source_time;
+
+	int num_verts;					// welded vertices, shared by the position/normal/uv sections
+	int num_faces;					// faces of all levels of detail
+	int num_meshlets;
+	int num_occluders;				// faces in the occluder section
+	int num_lods;
+	float bbox_min[3];
+	float bbox_max[3];
+	float bsphere_center[3];
+	float bsphere_radius;
+
+	mesh_section_t sections[MESH_SECTION_NUM];
+} mesh_cache_header_t;
+
+std::string mesh_cache_path(const char *obj_filename);
+void mesh_cache_init_header(mesh_cache_header_t &header, const char *obj_filename, unsigned int flags);
+
+// return NULL if the cache is missing, corrupted or out of date
+mapped_file_t *mesh_cache_open(const char *cache_filename, const mesh_cache_header_t &expected);
+const void *mesh_cache_section(const mapped_file_t *file, mesh_section section);
+
+// sizes of the sections are taken from header.sections[i].size, offsets are filled in
+bool mesh_cache_write(const char *cache_filename, mesh_cache_header_t &header, const void *const *section_data);
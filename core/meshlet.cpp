@@ -0,0 +1,117 @@
+#include "./meshlet.h"
+
+// refer to: https://github.com/zeux/meshoptimizer, computeClusterBounds
+static void compute_bounds(meshlet_t &meshlet, const unsigned int *indices, const vec3 *positions)
+{
+	const unsigned int *begin = indices + meshlet.face_offset * 3;
+	int num_indices = meshlet.face_count * 3;
+
+	// sphere around the center of the bounding box
+	vec3 bbox_min = positions[begin[0]], bbox_max = positions[begin[0]];
+	for (int i = 1; i < num_indices; i++)
+	{
+		const vec3 &p = positions[begin[i]];
+		for (int j = 0; j < 3; j++)
+		{
+			bbox_min[j] = float_min(bbox_min[j], p[j]);
+			bbox_max[j] = float_max(bbox_max[j], p[j]);
+		}
+	}
+	meshlet.center = (bbox_min + bbox_max) * 0.5f;
+	float radius_squared = 0;
+	for (int i = 0; i < num_indices; i++)
+		radius_squared = float_max(radius_squared, (positions[begin[i]] - meshlet.center).norm_squared());
+	meshlet.radius = sqrtf(radius_squared);
+
+	// the cone axis is the average face normal, its spread is the widest face normal
+	vec3 normals[MESHLET_MAX_FACES];
+	vec3 axis(0, 0, 0);
+	int num_normals = 0;
+	for (int i = 0; i < meshlet.face_count; i++)
+	{
+		const vec3 &a = positions[begin[i * 3]];
+		const vec3 &b = positions[begin[i * 3 + 1]];
+		const vec3 &c = positions[begin[i * 3 + 2]];
+		vec3 n = cross(b - a, c - a);
+		float length = n.norm();
+		if (length > 0)
+		{
+			normals[num_normals++] = n / length;
+			axis += n / length;
+		}
+	}
+
+	meshlet.cone_axis = vec3(0, 0, 1);
+	meshlet.cone_cutoff = 1;
+	float length = axis.norm();
+	if (num_normals == 0 || length <= 0)
+		return;
+	axis /= length;
+
+	float min_dot = 1;
+	for (int i = 0; i < num_normals; i++)
+		min_dot = float_min(min_dot, (float)dot(normals[i], axis));
+
+	// a cone wider than ~84 degrees is almost never culled
+	if (min_dot <= 0.1f)
+		return;
+	meshlet.cone_axis = axis;
+	meshlet.cone_cutoff = sqrtf(1 - min_dot * min_dot);
+}
+
+void build_meshlets(const unsigned int *indices, int num_faces, const vec3 *positions, int num_verts,
+	std::vector<meshlet_t> &meshlets)
+{
+	std::vector<int> last_meshlet(num_verts, -1);
+	meshlets.clear();
+
+	meshlet_t meshlet = meshlet_t();
+	for (int f = 0; f < num_faces; f++)
+	{
+		const unsigned int *face = indices + f * 3;
+		int id = (int)meshlets.size();
+		int new_verts = (last_meshlet[face[0]] != id)
+			+ (last_meshlet[face[1]] != id && face[1] != face[0])
+			+ (last_meshlet[face[2]] != id && face[2] != face[0] && face[2] != face[1]);
+
+		if (meshlet.face_count == MESHLET_MAX_FACES || meshlet.vertex_count + new_verts > MESHLET_MAX_VERTICES)
+		{
+			compute_bounds(meshlet, indices, positions);
+			meshlets.push_back(meshlet);
+			meshlet = meshlet_t();
+			meshlet.face_offset = f;
+			id++;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (last_meshlet[face[k]] != id)
+			{
+				last_meshlet[face[k]] = id;
+				meshlet.vertex_count++;
+			}
+		}
+		meshlet.face_count++;
+	}
+
+	if (meshlet.face_count > 0)
+	{
+		compute_bounds(meshlet, indices, positions);
+		meshlets.push_back(meshlet);
+	}
+}
+
+int meshlet_is_culled(const meshlet_t &meshlet, const vec4 planes[6], const vec3 &camera_pos, int backface_culling)
+{
+	if (sphere_outside_frustum(planes, meshlet.center, meshlet.radius))
+		return 1;
+
+	// every face is back-facing if the camera sits inside the cone behind the sphere
+	if (backface_culling && meshlet.cone_cutoff < 1)
+	{
+		vec3 view = meshlet.center - camera_pos;
+		if (dot(view, meshlet.cone_axis) >= meshlet.cone_cutoff * view.norm() + meshlet.radius)
+			return 1;
+	}
+	return 0;
+}
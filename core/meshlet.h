@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+
+#include "./maths.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_FACES 124
+
+// a run of consecutive faces of the index buffer, small enough to be culled as a whole
+typedef struct
+{
+	int face_offset;
+	int face_count;
+	int vertex_count;		// unique vertices used by the faces
+
+	// bounding sphere in model space
+	vec3 center;
+	float radius;
+
+	// normal cone, cone_cutoff is 1 when the faces point in too many directions to be culled
+	vec3 cone_axis;
+	float cone_cutoff;
+} meshlet_t;
+
+// split the index buffer (in its current order) into meshlets
+void build_meshlets(const unsigned int *indices, int num_faces, const vec3 *positions, int num_verts,
+	std::vector<meshlet_t> &meshlets);
+
+// planes are in model space, see frustum_planes(). back-facing meshlets are only culled
+// when backface_culling is set
+int meshlet_is_culled(const meshlet_t &meshlet, const vec4 planes[6], const vec3 &camera_pos, int backface_culling);
@@ -0,0 +1,300 @@
+#include "./meshopt.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/* vertex cache optimization */
+// refer to: https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+static const int CACHE_SIZE = 32;
+static const int MAX_VALENCE = 32;
+
+typedef struct
+{
+	float cache[CACHE_SIZE];
+	float valence[MAX_VALENCE + 1];
+} score_table_t;
+
+static score_table_t build_score_table()
+{
+	const float cache_decay_power = 1.5f;
+	const float last_face_score = 0.75f;
+	const float valence_boost_scale = 2.0f;
+	const float valence_boost_power = 0.5f;
+
+	score_table_t table;
+	for (int i = 0; i < CACHE_SIZE; i++)
+	{
+		// the vertices of the last face get a fixed score, so its neighbours are not favoured
+		if (i < 3)
+			table.cache[i] = last_face_score;
+		else
+			table.cache[i] = (float)pow(1.0f - (i - 3) / (float)(CACHE_SIZE - 3), cache_decay_power);
+	}
+
+	// boost vertices with few faces left, so lone faces are not left behind
+	table.valence[0] = 0;
+	for (int i = 1; i <= MAX_VALENCE; i++)
+		table.valence[i] = valence_boost_scale * (float)pow((float)i, -valence_boost_power);
+	return table;
+}
+
+static inline float vertex_score(const score_table_t &table, int cache_pos, int live_faces)
+{
+	if (live_faces == 0)
+		return -1.0f;
+
+	float score = cache_pos >= 0 ? table.cache[cache_pos] : 0.0f;
+	return score + table.valence[live_faces < MAX_VALENCE ? live_faces : MAX_VALENCE];
+}
+
+void optimize_vertex_cache(unsigned int *indices, int num_faces, int num_verts)
+{
+	if (num_faces == 0)
+		return;
+
+	static const score_table_t table = build_score_table();
+	int num_indices = num_faces * 3;
+
+	// faces adjacent to every vertex, only the first live[v] entries are still to be emitted
+	std::vector<int> live(num_verts, 0);
+	std::vector<int> offsets(num_verts + 1, 0);
+	std::vector<int> adjacency(num_indices);
+	for (int i = 0; i < num_indices; i++)
+		live[indices[i]]++;
+	for (int v = 0; v < num_verts; v++)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+	for (int i = 0; i < num_indices; i++)
+		adjacency[cursor[indices[i]]++] = i / 3;
+
+	std::vector<int> cache_pos(num_verts, -1);
+	std::vector<float> vert_score(num_verts);
+	std::vector<float> face_score(num_faces, 0);
+	std::vector<char> emitted(num_faces, 0);
+	for (int v = 0; v < num_verts; v++)
+		vert_score[v] = vertex_score(table, -1, live[v]);
+	for (int i = 0; i < num_indices; i++)
+		face_score[i / 3] += vert_score[indices[i]];
+
+	int best_face = (int)(std::max_element(face_score.begin(), face_score.end()) - face_score.begin());
+	int next_unemitted = 0;
+	int cache[CACHE_SIZE + 3], cache_count = 0;
+	int new_cache[CACHE_SIZE + 3];
+	std::vector<unsigned int> output(num_indices);
+
+	for (int n = 0; n < num_faces; n++)
+	{
+		// dead end, continue with the next face in input order
+		if (best_face < 0)
+		{
+			while (emitted[next_unemitted])
+				next_unemitted++;
+			best_face = next_unemitted;
+		}
+
+		const unsigned int *face = indices + best_face * 3;
+		memcpy(&output[n * 3], face, sizeof(unsigned int) * 3);
+		emitted[best_face] = 1;
+
+		// remove the face from the adjacency of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = face[k];
+			int *begin = &adjacency[offsets[v]];
+			int *last = begin + live[v] - 1;
+			for (int *it = begin; it <= last; it++)
+			{
+				if (*it == best_face)
+				{
+					std::swap(*it, *last);
+					live[v]--;
+					break;
+				}
+			}
+		}
+
+		// move the vertices of the face to the front of the lru cache
+		int new_count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			int v = (int)face[k];
+			if (std::find(new_cache, new_cache + new_count, v) == new_cache + new_count)
+				new_cache[new_count++] = v;
+		}
+		for (int i = 0; i < cache_count; i++)
+		{
+			int v = cache[i];
+			if (v != (int)face[0] && v != (int)face[1] && v != (int)face[2])
+				new_cache[new_count++] = v;
+		}
+		for (int i = 0; i < new_count; i++)
+			cache_pos[new_cache[i]] = i < CACHE_SIZE ? i : -1;
+		cache_count = new_count < CACHE_SIZE ? new_count : CACHE_SIZE;
+		memcpy(cache, new_cache, sizeof(int) * cache_count);
+
+		// rescore the touched vertices (including the ones pushed out) and their faces
+		for (int i = 0; i < new_count; i++)
+		{
+			int v = new_cache[i];
+			float score = vertex_score(table, cache_pos[v], live[v]);
+			float delta = score - vert_score[v];
+			vert_score[v] = score;
+			for (int j = 0; j < live[v]; j++)
+				face_score[adjacency[offsets[v] + j]] += delta;
+		}
+
+		// the next face is the best one using a vertex in the cache
+		best_face = -1;
+		float best_score = -1.0f;
+		for (int i = 0; i < cache_count; i++)
+		{
+			int v = cache[i];
+			for (int j = 0; j < live[v]; j++)
+			{
+				int f = adjacency[offsets[v] + j];
+				if (face_score[f] > best_score)
+				{
+					best_score = face_score[f];
+					best_face = f;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output.data(), sizeof(unsigned int) * num_indices);
+}
+
+/* fifo cache simulation */
+// a vertex is in the cache if it was added less than cache_size misses ago,
+// adding cache_size + 1 to the timestamp flushes the whole cache
+static inline int count_misses(const unsigned int *face, std::vector<unsigned int> &timestamps,
+	unsigned int &timestamp, int cache_size)
+{
+	int misses = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		if (timestamp - timestamps[face[k]] > (unsigned int)cache_size)
+		{
+			timestamps[face[k]] = timestamp++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+float vertex_cache_acmr(const unsigned int *indices, int num_faces, int num_verts, int cache_size)
+{
+	if (num_faces == 0)
+		return 0;
+
+	std::vector<unsigned int> timestamps(num_verts, 0);
+	unsigned int timestamp = cache_size + 1;
+	int misses = 0;
+	for (int i = 0; i < num_faces; i++)
+		misses += count_misses(indices + i * 3, timestamps, timestamp, cache_size);
+	return misses / (float)num_faces;
+}
+
+/* overdraw optimization */
+typedef struct
+{
+	int start;
+	int end;
+	float sort_key;
+} face_cluster_t;
+
+void optimize_overdraw(unsigned int *indices, int num_faces, const vec3 *positions, int num_verts, float threshold)
+{
+	if (num_faces == 0)
+		return;
+
+	const int cache_size = 16;
+	std::vector<unsigned int> timestamps(num_verts, 0);
+	unsigned int timestamp = cache_size + 1;
+
+	// hard boundaries, a face with three cache misses starts a new region of the mesh
+	std::vector<int> hard_starts;
+	for (int i = 0; i < num_faces; i++)
+	{
+		if (count_misses(indices + i * 3, timestamps, timestamp, cache_size) == 3 || i == 0)
+			hard_starts.push_back(i);
+	}
+	hard_starts.push_back(num_faces);
+
+	// soft boundaries, split a region again whenever its cache efficiency so far is
+	// within the threshold of the whole region, the cache is flushed at every split
+	std::vector<face_cluster_t> clusters;
+	for (size_t c = 0; c + 1 < hard_starts.size(); c++)
+	{
+		int start = hard_starts[c], end = hard_starts[c + 1];
+
+		timestamp += cache_size + 1;
+		int region_misses = 0;
+		for (int i = start; i < end; i++)
+			region_misses += count_misses(indices + i * 3, timestamps, timestamp, cache_size);
+		float region_threshold = threshold * region_misses / (float)(end - start);
+
+		timestamp += cache_size + 1;
+		int cluster_start = start, cluster_misses = 0;
+		for (int i = start; i < end; i++)
+		{
+			cluster_misses += count_misses(indices + i * 3, timestamps, timestamp, cache_size);
+			int cluster_faces = i + 1 - cluster_start;
+			if (i + 1 == end || cluster_misses / (float)cluster_faces <= region_threshold)
+			{
+				face_cluster_t cluster = { cluster_start, i + 1, 0 };
+				clusters.push_back(cluster);
+				cluster_start = i + 1;
+				cluster_misses = 0;
+				timestamp += cache_size + 1;
+			}
+		}
+	}
+
+	// area weighted centroid of the mesh
+	vec3 mesh_centroid(0, 0, 0);
+	float mesh_area = 0;
+	for (int i = 0; i < num_faces; i++)
+	{
+		const vec3 &a = positions[indices[i * 3]];
+		const vec3 &b = positions[indices[i * 3 + 1]];
+		const vec3 &c = positions[indices[i * 3 + 2]];
+		float area = cross(b - a, c - a).norm();
+		mesh_centroid += (a + b + c) * (area / 3.0f);
+		mesh_area += area;
+	}
+	if (mesh_area > 0)
+		mesh_centroid /= mesh_area;
+
+	// clusters facing away from the center of the mesh are likely occluders, draw them first
+	for (size_t k = 0; k < clusters.size(); k++)
+	{
+		vec3 centroid(0, 0, 0), normal(0, 0, 0);
+		float area_sum = 0;
+		for (int i = clusters[k].start; i < clusters[k].end; i++)
+		{
+			const vec3 &a = positions[indices[i * 3]];
+			const vec3 &b = positions[indices[i * 3 + 1]];
+			const vec3 &c = positions[indices[i * 3 + 2]];
+			vec3 n = cross(b - a, c - a);
+			float area = n.norm();
+			centroid += (a + b + c) * (area / 3.0f);
+			normal += n;
+			area_sum += area;
+		}
+		if (area_sum > 0)
+			centroid /= area_sum;
+		float length = normal.norm();
+		clusters[k].sort_key = length > 0 ? (float)dot(centroid - mesh_centroid, normal / length) : 0;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const face_cluster_t &a, const face_cluster_t &b) { return a.sort_key > b.sort_key; });
+
+	std::vector<unsigned int> output;
+	output.reserve(num_faces * 3);
+	for (size_t c = 0; c < clusters.size(); c++)
+		output.insert(output.end(), indices + clusters[c].start * 3, indices + clusters[c].end * 3);
+	memcpy(indices, output.data(), sizeof(unsigned int) * num_faces * 3);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "./maths.h"
+
+// load-time reordering of the index buffer, the corners of every face keep their winding
+
+// reorder faces for post-transform vertex cache locality (Forsyth's linear-speed algorithm)
+void optimize_vertex_cache(unsigned int *indices, int num_faces, int num_verts);
+
+// split a cache optimized order into clusters and sort them so that faces likely to
+// occlude the rest of the mesh come first (Sander et al. 2007, "Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw"). threshold is the tolerated loss of vertex
+// cache efficiency, e.g. 1.05
+void optimize_overdraw(unsigned int *indices, int num_faces, const vec3 *positions, int num_verts, float threshold);
+
+// average cache miss ratio of the index buffer for a fifo cache of the given size
+float vertex_cache_acmr(const unsigned int *indices, int num_faces, int num_verts, int cache_size);
@@ -1,77 +1,587 @@
 #include "./model.h"
 
-#include <io.h> 
+#include <cstring>
+#include <filesystem>
+#include <functional>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+
+#include "./filemap.h"
+#include "./jobsystem.h"
+#include "./meshcache.h"
+#include "./meshopt.h"
+#include "./occlusion.h"
+#include "./simplify.h"
+#include "./trace.h"
 
 #include "../shader/shader.h"
 
-Model::Model(const char *filename, int is_skybox, int is_from_mmd)
-	: is_skybox(is_skybox), is_from_mmd(is_from_mmd)
+/* fast obj parsing */
+// the file is memory mapped and scanned in two passes: the first pass counts the
+// elements of each chunk to reserve storage, the second one parses every chunk
+// straight into its final position, so large files can be parsed in parallel
+typedef struct
 {
-	std::ifstream in;
-	in.open(filename, std::ifstream::in);
-	if (in.fail())
+	int verts;
+	int norms;
+	int uvs;
+	int faces;
+} obj_counts_t;
+
+typedef struct
+{
+	const char *begin;
+	const char *end;
+	obj_counts_t count;		// elements inside this chunk
+	obj_counts_t offset;	// elements before this chunk
+} obj_chunk_t;
+
+static const int OBJ_CHUNK_SIZE = 1 << 20;
+
+static inline int is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skip_blank(const char *p, const char *end)
+{
+	while (p < end && is_blank(*p))
+		p++;
+	return p;
+}
+
+static inline const char *next_line(const char *p, const char *end)
+{
+	const char *eol = (const char *)memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+static const double POWER_OF_TEN[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+};
+
+static const char *parse_float(const char *p, const char *end, float &value)
+{
+	double sign = 1.0;
+	p = skip_blank(p, end);
+	if (p < end && (*p == '-' || *p == '+'))
 	{
-		printf("load model failed\n");
-		return;
+		if (*p == '-') sign = -1.0;
+		p++;
 	}
 
-	std::string line;
-	while (!in.eof()) {
-		std::getline(in, line);
-		std::istringstream iss(line.c_str());
-		char trash;
-		if (!line.compare(0, 2, "v ")) 
+	// mantissa, only the first 19 digits are significant for a 64-bit integer
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+	{
+		if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; }
+		else exponent++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
 		{
-			iss >> trash;
-			vec3 v;
-			for (int i = 0; i < 3; i++)
-				iss >> v[i];
-		
-			verts.push_back(v);
+			if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; exponent--; }
 		}
-		else if (!line.compare(0, 3, "vn ")) 
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		int exp_sign = 1, exp_value = 0;
+		p++;
+		if (p < end && (*p == '-' || *p == '+'))
 		{
-			iss >> trash >> trash;
-			vec3 n;
-			for (int i = 0; i < 3; i++) 
-				iss >> n[i];
+			if (*p == '-') exp_sign = -1;
+			p++;
+		}
+		for (; p < end && *p >= '0' && *p <= '9'; p++)
+			exp_value = exp_value * 10 + (*p - '0');
+		exponent += exp_sign * exp_value;
+	}
+
+	double result = (double)mantissa;
+	if (exponent < 0)
+		result = exponent >= -21 ? result / POWER_OF_TEN[-exponent] : result * pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 21 ? result * POWER_OF_TEN[exponent] : result * pow(10.0, exponent);
+
+	value = (float)(sign * result);
+	return p;
+}
+
+// return NULL if there is no integer at p
+static const char *parse_int(const char *p, const char *end, int &value)
+{
+	int sign = 1;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		if (*p == '-') sign = -1;
+		p++;
+	}
+	if (p >= end || *p < '0' || *p > '9')
+		return NULL;
+
+	int result = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+		result = result * 10 + (*p - '0');
+	value = sign * result;
+	return p;
+}
 
-			norms.push_back(n);
+// in wavefront obj all indices start at 1, not zero, and negative ones are relative to the end
+static inline int resolve_index(int index, int count)
+{
+	return index < 0 ? count + index : index - 1;
+}
+
+static void count_chunk(obj_chunk_t &chunk)
+{
+	obj_counts_t &c = chunk.count;
+	c.verts = c.norms = c.uvs = c.faces = 0;
+
+	for (const char *p = chunk.begin; p < chunk.end; p = next_line(p, chunk.end))
+	{
+		p = skip_blank(p, chunk.end);
+		if (chunk.end - p < 2)
+			continue;
+
+		if (p[0] == 'v')
+		{
+			if (is_blank(p[1]))			c.verts++;
+			else if (p[1] == 'n')		c.norms++;
+			else if (p[1] == 't')		c.uvs++;
 		}
-		else if (!line.compare(0, 3, "vt ")) 
+		else if (p[0] == 'f' && is_blank(p[1]))
+			c.faces++;
+	}
+}
+
+static void parse_chunk(obj_chunk_t &chunk, vec3 *verts, vec3 *norms, vec2 *uvs,
+	int *faces, int is_from_mmd)
+{
+	obj_counts_t c = chunk.offset;
+	const char *end = chunk.end;
+	int tmp[3];
+
+	for (const char *p = chunk.begin; p < end; p = next_line(p, end))
+	{
+		p = skip_blank(p, end);
+		if (end - p < 2)
+			continue;
+
+		if (p[0] == 'v' && is_blank(p[1]))
+		{
+			vec3 &v = verts[c.verts++];
+			p += 1;
+			for (int i = 0; i < 3; i++)
+				p = parse_float(p, end, v[i]);
+		}
+		else if (p[0] == 'v' && p[1] == 'n')
 		{
-			iss >> trash >> trash;
-			vec2 uv;
-			for (int i = 0; i < 2; i++) 
-				iss >> uv[i];
+			vec3 &n = norms[c.norms++];
+			p += 2;
+			for (int i = 0; i < 3; i++)
+				p = parse_float(p, end, n[i]);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			vec2 &uv = uvs[c.uvs++];
+			p += 2;
+			for (int i = 0; i < 2; i++)
+				p = parse_float(p, end, uv[i]);
 
 			if (is_from_mmd)
 				uv[1] = 1 - uv[1];
-			uvs.push_back(uv);
 		}
-		else if (!line.compare(0, 2, "f ")) 
+		else if (p[0] == 'f' && is_blank(p[1]))
 		{
-			std::vector<int> f;
-			int tmp[3];
-			iss >> trash;
-			while (iss >> tmp[0] >> trash >> tmp[1] >> trash >> tmp[2]) 
+			int *f = faces + (c.faces++) * 9;
+			p += 1;
+			// only complete vertex/uv/normal triples are accepted, and like before
+			// only the first three corners of a polygon are used
+			for (int n = 0; n < 3; n++)
 			{
-				for (int i = 0; i < 3; i++) 
-					tmp[i]--; // in wavefront obj all indices start at 1, not zero
+				const char *q = skip_blank(p, end);
+				if (!(q = parse_int(q, end, tmp[0])) || q >= end || *q++ != '/') break;
+				if (!(q = parse_int(q, end, tmp[1])) || q >= end || *q++ != '/') break;
+				if (!(q = parse_int(q, end, tmp[2]))) break;
+				p = q;
+
+				f[n * 3]     = resolve_index(tmp[0], c.verts);
+				f[n * 3 + 1] = resolve_index(tmp[1], c.uvs);
+				f[n * 3 + 2] = resolve_index(tmp[2], c.norms);
+			}
+		}
+	}
+}
+
+/* vertex welding */
+// every unique vertex/uv/normal triple of the obj file becomes one vertex, found
+// with an open addressing hash table keyed by the triple
+static inline unsigned int hash_triple(const int *t)
+{
+	unsigned int h = (unsigned int)t[0] * 73856093u;
+	h ^= (unsigned int)t[1] * 19349663u;
+	h ^= (unsigned int)t[2] * 83492791u;
+	return h ^ (h >> 15);
+}
+
+static void weld_vertices(const std::vector<vec3> &obj_verts, const std::vector<vec3> &obj_norms,
+	const std::vector<vec2> &obj_uvs, const std::vector<int> &obj_faces,
+	std::vector<vec3> &positions, std::vector<vec3> &normals, std::vector<vec2> &uvs,
+	std::vector<unsigned int> &indices)
+{
+	size_t num_corners = obj_faces.size() / 3;
+	size_t table_size = 1;
+	while (table_size < num_corners * 2)
+		table_size *= 2;
+	std::vector<unsigned int> table(table_size, ~0u);
+	std::vector<const int *> sources;		// first triple of each welded vertex
+
+	indices.resize(num_corners);
+	sources.reserve(num_corners / 4);
+	for (size_t i = 0; i < num_corners; i++)
+	{
+		const int *triple = &obj_faces[i * 3];
+		size_t slot = hash_triple(triple) & (table_size - 1);
+		while (table[slot] != ~0u && memcmp(sources[table[slot]], triple, sizeof(int) * 3) != 0)
+			slot = (slot + 1) & (table_size - 1);
+
+		if (table[slot] == ~0u)
+		{
+			table[slot] = (unsigned int)sources.size();
+			sources.push_back(triple);
+		}
+		indices[i] = table[slot];
+	}
+
+	// indices outside of the obj arrays, e.g. from an incomplete face, fall back to zero
+	size_t num_verts = sources.size();
+	positions.resize(num_verts);
+	normals.resize(num_verts);
+	uvs.resize(num_verts);
+	for (size_t i = 0; i < num_verts; i++)
+	{
+		const int *t = sources[i];
+		positions[i] = (t[0] >= 0 && t[0] < (int)obj_verts.size()) ? obj_verts[t[0]] : vec3(0, 0, 0);
+		uvs[i]       = (t[1] >= 0 && t[1] < (int)obj_uvs.size())   ? obj_uvs[t[1]]   : vec2(0, 0);
+		normals[i]   = (t[2] >= 0 && t[2] < (int)obj_norms.size()) ? unit_vector(obj_norms[t[2]]) : vec3(0, 0, 0);
+	}
+}
+
+bool parse_obj(const char *filename, int is_from_mmd, std::vector<vec3> &positions, std::vector<vec3> &normals,
+	std::vector<vec2> &texcoords, std::vector<unsigned int> &indices)
+{
+	mapped_file_t *file = map_file(filename);
+	if (file == NULL)
+		return false;
+
+	// split the file into chunks on line boundaries
+	const char *data = file->data;
+	const char *data_end = file->data + file->size;
+	std::vector<obj_chunk_t> chunks;
+	for (const char *p = data; p < data_end;)
+	{
+		obj_chunk_t chunk;
+		chunk.begin = p;
+		chunk.end = data_end - p > OBJ_CHUNK_SIZE ? next_line(p + OBJ_CHUNK_SIZE, data_end) : data_end;
+		chunks.push_back(chunk);
+		p = chunk.end;
+	}
+
+	int num_chunks = (int)chunks.size();
+	auto for_each_chunk = [&](const std::function<void(obj_chunk_t &chunk)> &work)
+	{
+		parallel_for(0, num_chunks, 1, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				work(chunks[i]);
+		});
+	};
+
+	// first pass, count elements to reserve storage
+	for_each_chunk([](obj_chunk_t &chunk) { count_chunk(chunk); });
+
+	obj_counts_t total = { 0, 0, 0, 0 };
+	for (int i = 0; i < num_chunks; i++)
+	{
+		chunks[i].offset = total;
+		total.verts += chunks[i].count.verts;
+		total.norms += chunks[i].count.norms;
+		total.uvs   += chunks[i].count.uvs;
+		total.faces += chunks[i].count.faces;
+	}
+	std::vector<vec3> obj_verts(total.verts);
+	std::vector<vec3> obj_norms(total.norms);
+	std::vector<vec2> obj_uvs(total.uvs);
+	std::vector<int> obj_faces((size_t)total.faces * 9, 0);
+
+	// second pass, parse every chunk into its reserved range
+	for_each_chunk([&](obj_chunk_t &chunk)
+	{
+		parse_chunk(chunk, obj_verts.data(), obj_norms.data(), obj_uvs.data(), obj_faces.data(), is_from_mmd);
+	});
+	unmap_file(file);
+
+	weld_vertices(obj_verts, obj_norms, obj_uvs, obj_faces, positions, normals, texcoords, indices);
+	return true;
+}
+
+bool Model::load_obj(const char *filename)
+{
+	return parse_obj(filename, is_from_mmd, positions, normals, texcoords, indices);
+}
+
+bool Model::load_mesh(const char *filename)
+{
+#if USE_MESH_CACHE
+	if (load_mesh_cache(filename))
+		return true;
+#endif
+
+	if (!load_obj(filename))
+		return false;
+	process_mesh(mesh_flags());
+
+#if USE_MESH_CACHE
+	save_mesh_cache(filename);
+#endif
+	return true;
+}
 
-				f.push_back(tmp[0]); f.push_back(tmp[1]); f.push_back(tmp[2]);
+// the welded mesh is in the vectors, apply the MESH_FLAG_XXX processing and build the occluders,
+// bounding volumes and meshlets
+void Model::process_mesh(unsigned int flags)
+{
+	position_data = positions.data();
+	normal_data   = normals.data();
+	uv_data       = texcoords.data();
+	index_data    = indices.data();
+	num_verts     = (int)positions.size();
+	num_faces     = (int)indices.size() / 3;
+
+	// one-time reordering, the result is persisted by the mesh cache
+	if (flags & MESH_FLAG_OPTIMIZED)
+	{
+		float acmr_before = vertex_cache_acmr(indices.data(), num_faces, num_verts, 16);
+		optimize_vertex_cache(indices.data(), num_faces, num_verts);
+		optimize_overdraw(indices.data(), num_faces, position_data, num_verts, 1.05f);
+		printf("# acmr %.3f -> %.3f\n", acmr_before, vertex_cache_acmr(indices.data(), num_faces, num_verts, 16));
+	}
+
+	select_occluders(index_data, num_faces, position_data, OCCLUDER_MAX_FACES, occluders);
+	occluder_data = occluders.data();
+	num_occluders = (int)occluders.size() / 3;
+
+	// bounding box, and a sphere around its center
+	bbox_min = vec3(0, 0, 0);
+	bbox_max = vec3(0, 0, 0);
+	if (num_verts > 0)
+	{
+		bbox_min = bbox_max = position_data[0];
+		for (int i = 1; i < num_verts; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				bbox_min[j] = float_min(bbox_min[j], position_data[i][j]);
+				bbox_max[j] = float_max(bbox_max[j], position_data[i][j]);
 			}
-			faces.push_back(f);
 		}
 	}
-	std::cerr << "# v# " << verts.size() << " f# " << faces.size() << " vt# " << uvs.size() << " vn# " << norms.size() << std::endl;
+	bsphere_center = (bbox_min + bbox_max) * 0.5f;
+	float radius_squared = 0;
+	for (int i = 0; i < num_verts; i++)
+		radius_squared = float_max(radius_squared, (position_data[i] - bsphere_center).norm_squared());
+	bsphere_radius = sqrtf(radius_squared);
 
-	create_map(filename);
+	build_lods(flags);
+}
+
+/* levels of detail */
+static const int LOD_MIN_FACES = 256;
+static const float LOD_MAX_ERROR = 0.05f;		// relative to the bounding sphere
+static const float LOD_MIN_REDUCTION = 0.85f;	// stop when a level keeps more faces than this
+
+void Model::build_lods(unsigned int flags)
+{
+	// the full mesh is the first level, the simplified ones follow it in the index buffer
+	mesh_lod_t full = { 0, num_faces, 0, 0, 0 };
+	lods.assign(1, full);
+
+	// every level halves the faces of the previous one, its error adds up along the chain
+	std::vector<unsigned int> lod_indices;
+	if (flags & MESH_FLAG_LODS)
+		lod_indices.assign(indices.begin(), indices.end());
+	float error = 0;
+	while ((flags & MESH_FLAG_LODS) && (int)lods.size() < MAX_MESH_LODS)
+	{
+		int prev_faces = (int)lod_indices.size() / 3;
+		if (prev_faces / 2 < LOD_MIN_FACES)
+			break;
+		error += simplify_mesh(lod_indices, position_data, num_verts, prev_faces / 2, bsphere_radius * LOD_MAX_ERROR);
+		int lod_faces = (int)lod_indices.size() / 3;
+		if (lod_faces > prev_faces * LOD_MIN_REDUCTION)
+			break;
+		if (flags & MESH_FLAG_OPTIMIZED)
+			optimize_vertex_cache(lod_indices.data(), lod_faces, num_verts);
+		mesh_lod_t lod = { (int)indices.size() / 3, lod_faces, 0, 0, error };
+		indices.insert(indices.end(), lod_indices.begin(), lod_indices.end());
+		lods.push_back(lod);
+		printf("# lod %d faces# %d error %f\n", (int)lods.size() - 1, lod_faces, error);
+	}
+
+	// meshlets of every level, their face offsets point into the whole index buffer
+	std::vector<meshlet_t> lod_meshlets;
+	meshlets.clear();
+	for (size_t i = 0; i < lods.size(); i++)
+	{
+		build_meshlets(&indices[lods[i].face_offset * 3], lods[i].face_count, position_data, num_verts, lod_meshlets);
+		lods[i].meshlet_offset = (int)meshlets.size();
+		lods[i].meshlet_count = (int)lod_meshlets.size();
+		for (size_t m = 0; m < lod_meshlets.size(); m++)
+		{
+			lod_meshlets[m].face_offset += lods[i].face_offset;
+			meshlets.push_back(lod_meshlets[m]);
+		}
+	}
+
+	index_data   = indices.data();
+	meshlet_data = meshlets.data();
+	lod_data     = lods.data();
+	num_meshlets = (int)meshlets.size();
+	num_lods     = (int)lods.size();
+}
+
+/* binary mesh cache */
+unsigned int Model::mesh_flags()
+{
+	unsigned int flags = is_from_mmd ? MESH_FLAG_MMD : 0;
+#if MESH_OPTIMIZE
+	flags |= MESH_FLAG_OPTIMIZED;
+#endif
+#if MESH_LOD
+	flags |= MESH_FLAG_LODS;
+#endif
+	return flags;
+}
 
+static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 is mapped directly from the mesh cache");
+static_assert(sizeof(vec2) == 2 * sizeof(float), "vec2 is mapped directly from the mesh cache");
+static_assert(sizeof(meshlet_t) == 3 * sizeof(int) + 8 * sizeof(float), "meshlet_t is mapped directly from the mesh cache");
+static_assert(sizeof(mesh_lod_t) == 4 * sizeof(int) + sizeof(float), "mesh_lod_t is mapped directly from the mesh cache");
+
+bool Model::load_mesh_cache(const char *filename)
+{
+	mesh_cache_header_t expected;
+	mesh_cache_init_header(expected, filename, mesh_flags());
+	if (expected.source_size == 0)
+		return false;
+
+	std::string cache_file = mesh_cache_path(filename);
+	mapped_file_t *file = mesh_cache_open(cache_file.c_str(), expected);
+	if (file == NULL)
+		return false;
+
+	const mesh_cache_header_t *header = (const mesh_cache_header_t *)file->data;
+	if (header->num_lods < 1 || header->sections[MESH_SECTION_LODS].size != sizeof(mesh_lod_t) * header->num_lods)
+	{
+		unmap_file(file);
+		return false;
+	}
+	const mesh_lod_t *cached_lods = (const mesh_lod_t *)mesh_cache_section(file, MESH_SECTION_LODS);
+	if (header->sections[MESH_SECTION_VERTS].size   != sizeof(vec3) * header->num_verts ||
+		header->sections[MESH_SECTION_NORMS].size   != sizeof(vec3) * header->num_verts ||
+		header->sections[MESH_SECTION_UVS].size     != sizeof(vec2) * header->num_verts ||
+		header->sections[MESH_SECTION_INDICES].size != sizeof(unsigned int) * 3 * header->num_faces ||
+		header->sections[MESH_SECTION_MESHLETS].size != sizeof(meshlet_t) * header->num_meshlets ||
+		header->sections[MESH_SECTION_OCCLUDERS].size != sizeof(unsigned int) * 3 * header->num_occluders)
+	{
+		unmap_file(file);
+		return false;
+	}
+
+	mesh_cache    = file;
+	position_data = (const vec3 *)mesh_cache_section(file, MESH_SECTION_VERTS);
+	normal_data   = (const vec3 *)mesh_cache_section(file, MESH_SECTION_NORMS);
+	uv_data       = (const vec2 *)mesh_cache_section(file, MESH_SECTION_UVS);
+	index_data    = (const unsigned int *)mesh_cache_section(file, MESH_SECTION_INDICES);
+	meshlet_data  = (const meshlet_t *)mesh_cache_section(file, MESH_SECTION_MESHLETS);
+	occluder_data = (const unsigned int *)mesh_cache_section(file, MESH_SECTION_OCCLUDERS);
+	lod_data      = cached_lods;
+	num_verts     = header->num_verts;
+	num_faces     = cached_lods[0].face_count;
+	num_meshlets  = header->num_meshlets;
+	num_occluders = header->num_occluders;
+	num_lods      = header->num_lods;
+	bbox_min      = vec3(header->bbox_min[0], header->bbox_min[1], header->bbox_min[2]);
+	bbox_max      = vec3(header->bbox_max[0], header->bbox_max[1], header->bbox_max[2]);
+	bsphere_center = vec3(header->bsphere_center[0], header->bsphere_center[1], header->bsphere_center[2]);
+	bsphere_radius = header->bsphere_radius;
+	return true;
+}
+
+void Model::save_mesh_cache(const char *filename)
+{
+	mesh_cache_header_t header;
+	mesh_cache_init_header(header, filename, mesh_flags());
+	if (header.source_size == 0)
+		return;
+
+	int total_faces = lod_data[num_lods - 1].face_offset + lod_data[num_lods - 1].face_count;
+	header.num_verts = num_verts;
+	header.num_faces = total_faces;
+	header.num_meshlets = num_meshlets;
+	header.num_occluders = num_occluders;
+	header.num_lods = num_lods;
+	for (int i = 0; i < 3; i++)
+	{
+		header.bbox_min[i] = bbox_min[i];
+		header.bbox_max[i] = bbox_max[i];
+		header.bsphere_center[i] = bsphere_center[i];
+	}
+	header.bsphere_radius = bsphere_radius;
+
+	const void *sections[MESH_SECTION_NUM];
+	sections[MESH_SECTION_VERTS]   = position_data;
+	sections[MESH_SECTION_NORMS]   = normal_data;
+	sections[MESH_SECTION_UVS]     = uv_data;
+	sections[MESH_SECTION_INDICES] = index_data;
+	sections[MESH_SECTION_MESHLETS] = meshlet_data;
+	sections[MESH_SECTION_OCCLUDERS] = occluder_data;
+	sections[MESH_SECTION_LODS] = lod_data;
+	header.sections[MESH_SECTION_VERTS].size   = sizeof(vec3) * num_verts;
+	header.sections[MESH_SECTION_NORMS].size   = sizeof(vec3) * num_verts;
+	header.sections[MESH_SECTION_UVS].size     = sizeof(vec2) * num_verts;
+	header.sections[MESH_SECTION_INDICES].size = sizeof(unsigned int) * 3 * total_faces;
+	header.sections[MESH_SECTION_MESHLETS].size = sizeof(meshlet_t) * num_meshlets;
+	header.sections[MESH_SECTION_OCCLUDERS].size = sizeof(unsigned int) * 3 * num_occluders;
+	header.sections[MESH_SECTION_LODS].size = sizeof(mesh_lod_t) * num_lods;
+
+	std::string cache_file = mesh_cache_path(filename);
+	if (!mesh_cache_write(cache_file.c_str(), header, sections))
+		printf("write mesh cache failed: %s\n", cache_file.c_str());
+}
+
+Model::Model(const char *filename, int is_skybox, int is_from_mmd)
+	: is_skybox(is_skybox), is_from_mmd(is_from_mmd)
+{
+	TRACE_SCOPE("Model::Model");
+	position_data = NULL; normal_data = NULL; uv_data = NULL; index_data = NULL; meshlet_data = NULL;
+	occluder_data = NULL; lod_data = NULL;
+	num_verts = num_faces = num_meshlets = num_occluders = num_lods = 0;
+	mesh_cache = NULL;
 	environment_map = NULL;
+	if (!load_mesh(filename))
+	{
+		printf("load model failed\n");
+		create_map(NULL);
+		return;
+	}
+	printf("# welded vertices# %d faces# %d meshlets# %d lods# %d\n", num_verts, num_faces, num_meshlets, num_lods);
+
+	create_map(filename);
+
 	if (is_skybox)
 	{
 		environment_map = new cubemap_t();
@@ -79,6 +589,22 @@ Model::Model(const char *filename, int is_skybox, int is_from_mmd)
 	}
 }
 
+Model::Model(std::vector<vec3> &&positions, std::vector<vec3> &&normals, std::vector<vec2> &&texcoords,
+	std::vector<unsigned int> &&indices, unsigned int flags)
+	: positions(std::move(positions)), normals(std::move(normals)), texcoords(std::move(texcoords)),
+	indices(std::move(indices)), is_skybox(0), is_from_mmd(0)
+{
+	TRACE_SCOPE("Model::Model");
+	meshlet_data = NULL; occluder_data = NULL; lod_data = NULL;
+	num_meshlets = num_occluders = num_lods = 0;
+	mesh_cache = NULL;
+	environment_map = NULL;
+	process_mesh(flags);
+	printf("# welded vertices# %d faces# %d meshlets# %d lods# %d\n", num_verts, num_faces, num_meshlets, num_lods);
+
+	create_map(NULL);
+}
+
 Model::~Model() 
 {
 	if (diffusemap) delete diffusemap; diffusemap = NULL;
@@ -95,10 +621,13 @@ Model::~Model()
 			delete environment_map->faces[i];
 		delete environment_map;
 	}
+
+	if (mesh_cache) unmap_file(mesh_cache);
 }
 
 void Model::create_map(const char *filename)
 {
+	TRACE_SCOPE("create_map");
 	diffusemap		= NULL;
 	normalmap		= NULL;
 	specularmap		= NULL;
@@ -106,113 +635,131 @@ void Model::create_map(const char *filename)
 	metalnessmap	= NULL;
 	occlusion_map	= NULL;
 	emision_map		= NULL;
+	if (filename == NULL)
+		return;
 
 	std::string texfile(filename);
 	size_t dot = texfile.find_last_of(".");
 
-	texfile = texfile.substr(0, dot) + std::string("_diffuse.tga");
-	if (_access(texfile.data(), 0) != -1)
+	typedef struct
 	{
-		diffusemap = new TGAImage();
-		load_texture(filename, "_diffuse.tga", diffusemap);
-	}
-
-	texfile = texfile.substr(0, dot) + std::string("_normal.tga");
-	if (_access(texfile.data(), 0) != -1)
+		const char *suffix;
+		TGAImage **image;
+	} texture_slot_t;
+	texture_slot_t slots[] =
 	{
-		normalmap = new TGAImage();
-		load_texture(filename, "_normal.tga", normalmap);
-	}
-
-	texfile = texfile.substr(0, dot) + std::string("_spec.tga");
-	if (_access(texfile.data(), 0) != -1)
+		{ "_diffuse.tga",	&diffusemap },
+		{ "_normal.tga",	&normalmap },
+		{ "_spec.tga",		&specularmap },
+		{ "_roughness.tga",	&roughnessmap },
+		{ "_metalness.tga",	&metalnessmap },
+		{ "_emission.tga",	&emision_map },
+		{ "_occlusion.tga",	&occlusion_map },
+	};
+
+	// every texture is read and decoded by its own job
+	job_group_t group;
+	for (int i = 0; i < (int)(sizeof(slots) / sizeof(slots[0])); i++)
 	{
-		specularmap = new TGAImage();
-		load_texture(filename, "_spec.tga", specularmap);
+		texfile = texfile.substr(0, dot) + std::string(slots[i].suffix);
+		if (std::filesystem::exists(texfile))
+		{
+			TGAImage *image = new TGAImage();
+			const char *suffix = slots[i].suffix;
+			*slots[i].image = image;
+			job_submit(group, [this, filename, suffix, image]() { load_texture(filename, suffix, image); });
+		}
 	}
+	job_wait(group);
+}
 
-	texfile = texfile.substr(0, dot) + std::string("_roughness.tga");
-	if (_access(texfile.data(), 0) != -1)
+void Model::load_cubemap(const char *filename)
+{
+	const char *suffixes[6] = { "_right.tga", "_left.tga", "_top.tga", "_bottom.tga", "_back.tga", "_front.tga" };
+	job_group_t group;
+	for (int i = 0; i < 6; i++)
 	{
-		roughnessmap = new TGAImage();
-		load_texture(filename, "_roughness.tga", roughnessmap);
+		TGAImage *image = new TGAImage();
+		const char *suffix = suffixes[i];
+		environment_map->faces[i] = image;
+		job_submit(group, [this, filename, suffix, image]() { load_texture(filename, suffix, image); });
 	}
+	job_wait(group);
+}
 
-	texfile = texfile.substr(0, dot) + std::string("_metalness.tga");
-	if (_access(texfile.data(), 0) != -1)
-	{
-		metalnessmap = new TGAImage();
-		load_texture(filename, "_metalness.tga", metalnessmap);
-	}
+int Model::nverts() 
+{
+	return num_verts;
+}
 
-	texfile = texfile.substr(0, dot) + std::string("_emission.tga");
-	if (_access(texfile.data(), 0) != -1)
-	{
-		emision_map = new TGAImage();
-		load_texture(filename, "_emission.tga", emision_map);
-	}
+int Model::nfaces() 
+{
+	return num_faces;
+}
 
-	texfile = texfile.substr(0, dot) + std::string("_occlusion.tga");
-	if (_access(texfile.data(), 0) != -1)
-	{
-		occlusion_map = new TGAImage();
-		load_texture(filename, "_occlusion.tga", metalnessmap);
-	}
+const unsigned int *Model::face(int idx) 
+{
+	return index_data + idx * 3;
 }
 
-void Model::load_cubemap(const char *filename)
+int Model::nmeshlets() 
 {
-	environment_map->faces[0] = new TGAImage();
-	load_texture(filename, "_right.tga", environment_map->faces[0]);
-	environment_map->faces[1] = new TGAImage();
-	load_texture(filename, "_left.tga", environment_map->faces[1]);
-	environment_map->faces[2] = new TGAImage();
-	load_texture(filename, "_top.tga", environment_map->faces[2]);
-	environment_map->faces[3] = new TGAImage();
-	load_texture(filename, "_bottom.tga", environment_map->faces[3]);
-	environment_map->faces[4] = new TGAImage();
-	load_texture(filename, "_back.tga", environment_map->faces[4]);
-	environment_map->faces[5] = new TGAImage();
-	load_texture(filename, "_front.tga", environment_map->faces[5]);
+	return num_meshlets;
 }
 
-int Model::nverts() 
+const meshlet_t &Model::meshlet(int idx) 
 {
-	return (int)verts.size();
+	return meshlet_data[idx];
 }
 
-int Model::nfaces() 
+int Model::nlods() 
 {
-	return (int)faces.size();
+	return num_lods;
 }
 
-std::vector<int> Model::face(int idx) 
+const mesh_lod_t &Model::lod(int idx) 
 {
-	std::vector<int> face;
-	for (int i = 0; i < 3; i++) 
-		face.push_back(faces[idx][i*3]);
-	return face;
+	return lod_data[idx];
+}
+
+int Model::noccluders() 
+{
+	return num_occluders;
+}
+
+const unsigned int *Model::occluder(int idx) 
+{
+	return occluder_data + idx * 3;
 }
 
 vec3 Model::vert(int i) 
 {
-	return verts[i];
+	return position_data[i];
 }
 
 vec3 Model::vert(int iface, int nthvert) 
 {
-	return verts[faces[iface][nthvert*3]];
+	return position_data[index_data[iface * 3 + nthvert]];
+}
+
+vec2 Model::uv(int i) 
+{
+	return uv_data[i];
 }
 
 vec2 Model::uv(int iface, int nthvert) 
 {
-	return uvs[faces[iface][nthvert * 3+1]];
+	return uv_data[index_data[iface * 3 + nthvert]];
+}
+
+vec3 Model::normal(int i) 
+{
+	return normal_data[i];
 }
 
 vec3 Model::normal(int iface, int nthvert) 
 {
-	int idx = faces[iface][nthvert * 3+2];
-	return unit_vector(norms[idx]);
+	return normal_data[index_data[iface * 3 + nthvert]];
 }
 
 void Model::load_texture(std::string filename, const char *suffix, TGAImage &img) 
@@ -229,6 +776,7 @@ void Model::load_texture(std::string filename, const char *suffix, TGAImage &img
 
 void Model::load_texture(std::string filename, const char *suffix, TGAImage *img) 
 {
+	TRACE_SCOPE("load_texture");
 	std::string texfile(filename);
 	size_t dot = texfile.find_last_of(".");
 	if (dot != std::string::npos) {
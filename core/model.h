@@ -2,26 +2,64 @@
 #include <string>
 #include <vector>
 
+#include "./filemap.h"
 #include "./maths.h"
+#include "./meshlet.h"
+#include "./simplify.h"
 #include "./tgaimage.h"
 
 typedef struct cubemap cubemap_t; // forward declaration
 
+// parse an obj file into welded vertices and 3 indices per face, without the processing of Model
+bool parse_obj(const char *filename, int is_from_mmd, std::vector<vec3> &positions, std::vector<vec3> &normals,
+	std::vector<vec2> &texcoords, std::vector<unsigned int> &indices);
+
 class Model {
 private:
-	std::vector<vec3> verts;
-	std::vector<std::vector<int> > faces; // attention, this Vec3i means vertex/uv/normal
-	std::vector<vec3> norms;
-	std::vector<vec2> uvs;
+	// welded vertices of a freshly parsed obj, empty when the mesh comes from the cache
+	std::vector<vec3> positions;
+	std::vector<vec3> normals;		// normalized once at load time
+	std::vector<vec2> texcoords;
+	std::vector<unsigned int> indices;	// 3 vertex indices per face, the levels of detail one after another
+	std::vector<meshlet_t> meshlets;
+	std::vector<mesh_lod_t> lods;
+	std::vector<unsigned int> occluders;	// 3 vertex indices per occluder face
 
+	// mesh data, points either into the vectors above or into the mapped mesh cache
+	const vec3 *position_data;
+	const vec3 *normal_data;
+	const vec2 *uv_data;
+	const unsigned int *index_data;
+	const meshlet_t *meshlet_data;
+	const unsigned int *occluder_data;
+	const mesh_lod_t *lod_data;
+	int num_verts, num_faces, num_meshlets, num_occluders, num_lods;
+	mapped_file_t *mesh_cache;
 
+	bool load_mesh(const char *filename);
+	bool load_obj(const char *filename);
+	void process_mesh(unsigned int flags);
+	void build_lods(unsigned int flags);
+	unsigned int mesh_flags();
+	bool load_mesh_cache(const char *filename);
+	void save_mesh_cache(const char *filename);
 	void load_cubemap(const char *filename);
 	void create_map(const char *filename);
 	void load_texture(std::string filename, const char *suffix, TGAImage &img);
 	void load_texture(std::string filename, const char *suffix, TGAImage *img);
 public:
 	Model(const char *filename, int is_skybox = 0, int is_from_mmd = 0);
+	// mesh built in memory, e.g. a generated one, with 3 indices per face. flags are the
+	// MESH_FLAG_OPTIMIZED and MESH_FLAG_LODS processing applied to it, the maps are left empty
+	Model(std::vector<vec3> &&positions, std::vector<vec3> &&normals, std::vector<vec2> &&texcoords,
+		std::vector<unsigned int> &&indices, unsigned int flags);
 	~Model();
+	//bounding volumes in model space
+	vec3 bbox_min;
+	vec3 bbox_max;
+	vec3 bsphere_center;
+	float bsphere_radius;
+
 	//skybox
 	cubemap_t *environment_map;
 	int is_skybox;
@@ -38,11 +76,13 @@ public:
 
 	int nverts();
 	int nfaces();
+	vec3 normal(int i);
 	vec3 normal(int iface, int nthvert);
 	vec3 normal(vec2 uv);
 	vec3 vert(int i);
 	vec3 vert(int iface, int nthvert);
 
+	vec2 uv(int i);
 	vec2 uv(int iface, int nthvert);
 	vec3 diffuse(vec2 uv);
 	float roughness(vec2 uv);
@@ -51,5 +91,11 @@ public:
 	float occlusion(vec2 uv);
 	float specular(vec2 uv);
 
-	std::vector<int> face(int idx);
+	const unsigned int *face(int idx);
+	int nmeshlets();
+	const meshlet_t &meshlet(int idx);
+	int nlods();
+	const mesh_lod_t &lod(int idx);
+	int noccluders();
+	const unsigned int *occluder(int idx);
 };
\ No newline at end of file
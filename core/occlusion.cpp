@@ -0,0 +1,204 @@
+#include "./occlusion.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+#include "./model.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#else
+#define OCCLUSION_SSE 0
+#endif
+
+void select_occluders(const unsigned int *indices, int num_faces, const vec3 *positions, int max_faces,
+	std::vector<unsigned int> &occluders)
+{
+	std::vector<int> order(num_faces);
+	std::vector<float> areas(num_faces);
+	for (int i = 0; i < num_faces; i++)
+	{
+		const vec3 &a = positions[indices[i * 3]];
+		const vec3 &b = positions[indices[i * 3 + 1]];
+		const vec3 &c = positions[indices[i * 3 + 2]];
+		areas[i] = cross(b - a, c - a).norm_squared();
+		order[i] = i;
+	}
+
+	int count = num_faces < max_faces ? num_faces : max_faces;
+	std::partial_sort(order.begin(), order.begin() + count, order.end(),
+		[&areas](int a, int b) { return areas[a] > areas[b]; });
+	// keep the mesh order, which is already cache friendly
+	std::sort(order.begin(), order.begin() + count);
+
+	occluders.resize(count * 3);
+	for (int i = 0; i < count; i++)
+		memcpy(&occluders[i * 3], indices + order[i] * 3, sizeof(unsigned int) * 3);
+}
+
+void occlusion_clear(occlusion_buffer_t *buffer)
+{
+	for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; i++)
+		buffer->depth[i] = FLT_MAX;
+}
+
+// clip coordinate to occlusion buffer pixel, z is the view space distance
+// return 0 if the vertex is not in front of the camera
+static int project(const mat4 &mvp, const vec3 &p, vec3 &screen)
+{
+	vec4 clip = mvp * to_vec4(p, 1.0f);
+	if (clip.w() > -EPSILON)
+		return 0;
+	screen[0] = (clip.x() / clip.w() + 1.0f) * 0.5f * OCCLUSION_WIDTH;
+	screen[1] = (clip.y() / clip.w() + 1.0f) * 0.5f * OCCLUSION_HEIGHT;
+	screen[2] = -clip.w();
+	return 1;
+}
+
+static void draw_occluder(occlusion_buffer_t *buffer, const vec3 v[3])
+{
+	// back faces are culled when drawing, so they can not hide anything
+	float area = (v[1].x() - v[0].x()) * (v[2].y() - v[0].y()) - (v[2].x() - v[0].x()) * (v[1].y() - v[0].y());
+	if (area < EPSILON)
+		return;
+
+	// edge functions e(x, y) = a * x + b * y + c, a pixel is covered if its center is inside
+	// every edge, faces sharing an edge leave no holes between them
+	float a[3], b[3], c[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const vec3 &p0 = v[i];
+		const vec3 &p1 = v[(i + 1) % 3];
+		a[i] = p0.y() - p1.y();
+		b[i] = p1.x() - p0.x();
+		c[i] = p0.x() * p1.y() - p1.x() * p0.y();
+	}
+
+	// faces close to the eye plane project far outside of the buffer, clamp both ends of the
+	// rectangle before it is cast to int
+	float min_x = float_min(v[0].x(), float_min(v[1].x(), v[2].x()));
+	float min_y = float_min(v[0].y(), float_min(v[1].y(), v[2].y()));
+	float max_x = float_max(v[0].x(), float_max(v[1].x(), v[2].x()));
+	float max_y = float_max(v[0].y(), float_max(v[1].y(), v[2].y()));
+	if (max_x < 0 || max_y < 0 || min_x >= OCCLUSION_WIDTH || min_y >= OCCLUSION_HEIGHT)
+		return;
+
+	float depth = float_max(v[0].z(), float_max(v[1].z(), v[2].z()));
+	int xmin = (int)float_max(0, min_x);
+	int ymin = (int)float_max(0, min_y);
+	int xmax = (int)float_min(OCCLUSION_WIDTH - 1, max_x);
+	int ymax = (int)float_min(OCCLUSION_HEIGHT - 1, max_y);
+	xmin &= ~3;
+
+	for (int y = ymin; y <= ymax; y++)
+	{
+		float cy = y + 0.5f;
+		float *row = buffer->depth + y * OCCLUSION_WIDTH;
+#if OCCLUSION_SSE
+		__m128 depth4 = _mm_set1_ps(depth);
+		__m128 a4[3], e4[3];
+		for (int i = 0; i < 3; i++)
+		{
+			a4[i] = _mm_set1_ps(a[i] * 4.0f);
+			e4[i] = _mm_add_ps(_mm_set1_ps(b[i] * cy + c[i]),
+				_mm_mul_ps(_mm_set1_ps(a[i]), _mm_add_ps(_mm_set1_ps((float)xmin), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f))));
+		}
+		for (int x = xmin; x <= xmax; x += 4)
+		{
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e4[0], _mm_setzero_ps()),
+				_mm_and_ps(_mm_cmpge_ps(e4[1], _mm_setzero_ps()), _mm_cmpge_ps(e4[2], _mm_setzero_ps())));
+			__m128 old_depth = _mm_load_ps(row + x);
+			__m128 new_depth = _mm_min_ps(old_depth, depth4);
+			_mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+			for (int i = 0; i < 3; i++)
+				e4[i] = _mm_add_ps(e4[i], a4[i]);
+		}
+#else
+		for (int x = xmin; x <= xmax; x++)
+		{
+			float cx = x + 0.5f;
+			if (a[0] * cx + b[0] * cy + c[0] >= 0 && a[1] * cx + b[1] * cy + c[1] >= 0 && a[2] * cx + b[2] * cy + c[2] >= 0)
+				row[x] = float_min(row[x], depth);
+		}
+#endif
+	}
+}
+
+void occlusion_draw_occluders(occlusion_buffer_t *buffer, Model *model, const mat4 &mvp)
+{
+	for (int i = 0; i < model->noccluders(); i++)
+	{
+		const unsigned int *face = model->occluder(i);
+		vec3 screen[3];
+		// faces crossing the near plane are skipped, leaving them out is always safe
+		if (project(mvp, model->vert(face[0]), screen[0]) &&
+			project(mvp, model->vert(face[1]), screen[1]) &&
+			project(mvp, model->vert(face[2]), screen[2]))
+			draw_occluder(buffer, screen);
+	}
+}
+
+int occlusion_test_aabb(const occlusion_buffer_t *buffer, const mat4 &mvp, const vec3 &bbox_min, const vec3 &bbox_max)
+{
+	// screen rectangle and nearest depth of the eight corners
+	float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX, zmin = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner(i & 1 ? bbox_max[0] : bbox_min[0], i & 2 ? bbox_max[1] : bbox_min[1], i & 4 ? bbox_max[2] : bbox_min[2]);
+		vec3 screen;
+		if (!project(mvp, corner, screen))
+			return 1;	// the box crosses the near plane
+		xmin = float_min(xmin, screen.x()); xmax = float_max(xmax, screen.x());
+		ymin = float_min(ymin, screen.y()); ymax = float_max(ymax, screen.y());
+		zmin = float_min(zmin, screen.z());
+	}
+
+	if (xmax < 0 || ymax < 0 || xmin >= OCCLUSION_WIDTH || ymin >= OCCLUSION_HEIGHT)
+		return 0;
+
+	// occluders cover pixels by their centers, grow the rectangle by one pixel so the
+	// pixels partially covered along the silhouette of an occluder are tested as well
+	xmin -= 1.0f; ymin -= 1.0f;
+	xmax += 1.0f; ymax += 1.0f;
+	int x0 = (int)float_max(0, xmin);
+	int y0 = (int)float_max(0, ymin);
+	int x1 = (int)float_min(OCCLUSION_WIDTH - 1, xmax);
+	int y1 = (int)float_min(OCCLUSION_HEIGHT - 1, ymax);
+
+	// visible if any pixel of the rectangle is farther away than the box
+	for (int y = y0; y <= y1; y++)
+	{
+		const float *row = buffer->depth + y * OCCLUSION_WIDTH;
+#if OCCLUSION_SSE
+		int aligned_x0 = x0 & ~3;
+		__m128 zmin4 = _mm_set1_ps(zmin);
+		__m128 x4 = _mm_add_ps(_mm_set1_ps((float)aligned_x0), _mm_setr_ps(0, 1, 2, 3));
+		__m128 xmin4 = _mm_set1_ps((float)x0);
+		__m128 xmax4 = _mm_set1_ps((float)x1);
+		for (int x = aligned_x0; x <= x1; x += 4)
+		{
+			// lanes outside of the rectangle, from aligning the loads, are masked out
+			__m128 in_range = _mm_and_ps(_mm_cmpge_ps(x4, xmin4), _mm_cmple_ps(x4, xmax4));
+			__m128 farther = _mm_cmpge_ps(_mm_load_ps(row + x), zmin4);
+			if (_mm_movemask_ps(_mm_and_ps(in_range, farther)))
+				return 1;
+			x4 = _mm_add_ps(x4, _mm_set1_ps(4.0f));
+		}
+#else
+		for (int x = x0; x <= x1; x++)
+		{
+			if (row[x] >= zmin)
+				return 1;
+		}
+#endif
+	}
+	return 0;
+}
+
+int occlusion_test_sphere(const occlusion_buffer_t *buffer, const mat4 &mvp, const vec3 &center, float radius)
+{
+	vec3 extent(radius, radius, radius);
+	return occlusion_test_aabb(buffer, mvp, center - extent, center + extent);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+
+#include "./maths.h"
+
+class Model;
+
+// low resolution depth buffer for software occlusion culling. occluders are drawn
+// with the farthest depth of each face, so every depth in the buffer is a conservative
+// (far) bound of what is really drawn there
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+
+// the occluder subset of a model, faces with the largest area
+#define OCCLUDER_MAX_FACES 4096
+
+// the rows are read and written 4 floats at a time with aligned sse loads, allocate the buffer
+// with new (or another allocator that respects alignas) and not with malloc
+typedef struct
+{
+	alignas(16) float depth[OCCLUSION_WIDTH * OCCLUSION_HEIGHT];	// view space distance, larger is farther
+} occlusion_buffer_t;
+
+// pick the faces with the largest area as occluders, 3 vertex indices per face
+void select_occluders(const unsigned int *indices, int num_faces, const vec3 *positions, int max_faces,
+	std::vector<unsigned int> &occluders);
+
+void occlusion_clear(occlusion_buffer_t *buffer);
+void occlusion_draw_occluders(occlusion_buffer_t *buffer, Model *model, const mat4 &mvp);
+
+// return 0 only if the box is completely hidden behind the occluders (or off-screen)
+int occlusion_test_aabb(const occlusion_buffer_t *buffer, const mat4 &mvp, const vec3 &bbox_min, const vec3 &bbox_max);
+int occlusion_test_sphere(const occlusion_buffer_t *buffer, const mat4 &mvp, const vec3 &center, float radius);
@@ -1,6 +1,83 @@
 #include "./pipeline.h"
 
-static SpinLock sp;
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "./jobsystem.h"
+#include "./sample.h"
+#include "./spmcqueue.hpp"
+#include "./trace.h"
+
+static const int VERTEX_JOB_SIZE = 1024;
+static const int MESHLET_JOB_SIZE = 4;
+
+/* pipelined drawing */
+// a triangle after clipping and setup, waiting for the raster stage
+typedef struct
+{
+	vec4 clipcoord[3];
+	vec3 worldcoord[3];
+	vec3 normal[3];
+	vec2 uv[3];
+	vec3 screen_pos[3];
+	float bbox[4];
+} raster_triangle_t;
+
+static const int TRIANGLE_BATCH_SIZE = 64;
+typedef struct
+{
+	int count;
+	raster_triangle_t triangles[TRIANGLE_BATCH_SIZE];
+} triangle_batch_t;
+
+typedef SPMCQueue<triangle_batch_t, 8> triangle_queue_t;
+
+// meshlets that survived culling, with the view depth they are sorted by
+typedef struct
+{
+	int index;
+	float depth;
+} meshlet_draw_t;
+
+// counters of one thread, on a cache line of their own so the threads of a draw don't share one
+typedef struct alignas(64)
+{
+	draw_counters_t counters;
+} thread_counters_t;
+
+// state of the model currently being drawn with the context
+struct draw_context
+{
+	int width;		// size of the framebuffer, zbuffer or packed buffer the draws render into
+	int height;
+	// post-transform vertices, a vertex is valid for the current draw if its stamp equals draw_stamp
+	std::vector<vertex_out_t> vertex_buffer;
+	std::vector<unsigned int> vertex_stamp;
+	unsigned int draw_stamp = 0;
+	std::vector<unsigned int> shaded_vertices;	// unique vertices of the visible meshlets
+	std::vector<meshlet_draw_t> visible_meshlets;
+	// every geometry worker pushes its batches into its own queue, any raster worker pops them
+	std::vector<std::unique_ptr<triangle_queue_t>> triangle_queues;
+	// indexed by job_thread_index, the stages count through const contexts
+	mutable std::vector<thread_counters_t> thread_counters;
+};
+
+typedef struct
+{
+	draw_context_t *context;
+	packed_pixel_t *buffer;
+	const IShader *shader;
+	int num_queues;
+	std::atomic<int> next_meshlet;		// first entry of visible_meshlets no worker has taken yet
+	std::atomic<int> active_producers;	// geometry workers that started and still push batches
+} pipelined_draw_t;
+
+// counters of the calling thread, prepare_model sizes the slots before any job of the draw runs
+static draw_counters_t &thread_counters(const draw_context_t &context)
+{
+	return context.thread_counters[job_thread_index()].counters;
+}
 
 static int is_back_facing(vec3 ndc_pos[3])
 {
@@ -13,23 +90,23 @@ static int is_back_facing(vec3 ndc_pos[3])
 	return signed_area <= 0;
 }
 
-static vec3 compute_barycentric2D(float x, float y, const vec3* v) 
+vec3 compute_barycentric2D(float x, float y, const vec3* v) 
 {
 	float c1 = (x*(v[1].y() - v[2].y()) + (v[2].x() - v[1].x())*y + v[1].x()*v[2].y() - v[2].x()*v[1].y()) / (v[0].x()*(v[1].y() - v[2].y()) + (v[2].x() - v[1].x())*v[0].y() + v[1].x()*v[2].y() - v[2].x()*v[1].y());
 	float c2 = (x*(v[2].y() - v[0].y()) + (v[0].x() - v[2].x())*y + v[2].x()*v[0].y() - v[0].x()*v[2].y()) / (v[1].x()*(v[2].y() - v[0].y()) + (v[0].x() - v[2].x())*v[1].y() + v[2].x()*v[0].y() - v[0].x()*v[2].y());
 	return vec3(c1, c2, 1 - c1 - c2);
 }
 
-static void set_color(unsigned char* framebuffer, int x, int y, unsigned char color[])
+static void set_color(unsigned char* framebuffer, int width, int height, int x, int y, unsigned char color[])
 {
 	int i;
-	int index = ((WINDOW_HEIGHT - y - 1) * WINDOW_WIDTH + x) * 4; // the origin for pixel is bottom-left, but the framebuffer index counts from top-left
+	int index = ((height - y - 1) * width + x) * 4; // the origin for pixel is bottom-left, but the framebuffer index counts from top-left
 
 	for (i = 0; i < 3; i++)
 		framebuffer[index + i] = color[i];
 }
 
-static int is_inside_triangle(float alpha, float beta, float gamma)
+int is_inside_triangle(float alpha, float beta, float gamma)
 {
 	int flag = 0;
 	// here epsilon is to alleviate precision bug
@@ -39,9 +116,9 @@ static int is_inside_triangle(float alpha, float beta, float gamma)
 	return flag;
 }
 
-static int get_index(int x, int y)
+static int get_index(int width, int height, int x, int y)
 {
-	return (WINDOW_HEIGHT - y - 1) * WINDOW_WIDTH + x;
+	return (height - y - 1) * width + x;
 }
 
 
@@ -105,21 +182,21 @@ static float get_intersect_ratio(vec4 prev, vec4 curv,clip_plane c_plane)
 	}
 }
 
-static int clip_with_plane(clip_plane c_plane, int num_vert, payload_t &payload)
+static int clip_with_plane(clip_plane c_plane, int num_vert, varying_t &varying)
 {
 	int out_vert_num = 0;
 	int previous_index, current_index;
 	int is_odd = (c_plane + 1) % 2;
 	
 	// set the right in and out datas
-	vec4* in_clipcoord	 = is_odd ? payload.in_clipcoord: payload.out_clipcoord;
-	vec3* in_worldcoord  = is_odd ? payload.in_worldcoord: payload.out_worldcoord;
-	vec3* in_normal		 = is_odd ? payload.in_normal: payload.out_normal;
-	vec2* in_uv			 = is_odd ? payload.in_uv: payload.out_uv;
-	vec4* out_clipcoord  = is_odd ? payload.out_clipcoord: payload.in_clipcoord;
-	vec3* out_worldcoord = is_odd ? payload.out_worldcoord:payload.in_worldcoord;
-	vec3* out_normal	 = is_odd ? payload.out_normal: payload.in_normal;
-	vec2* out_uv		 = is_odd ? payload.out_uv: payload.in_uv;
+	vec4* in_clipcoord	 = is_odd ? varying.in_clipcoord: varying.out_clipcoord;
+	vec3* in_worldcoord  = is_odd ? varying.in_worldcoord: varying.out_worldcoord;
+	vec3* in_normal		 = is_odd ? varying.in_normal: varying.out_normal;
+	vec2* in_uv			 = is_odd ? varying.in_uv: varying.out_uv;
+	vec4* out_clipcoord  = is_odd ? varying.out_clipcoord: varying.in_clipcoord;
+	vec3* out_worldcoord = is_odd ? varying.out_worldcoord:varying.in_worldcoord;
+	vec3* out_normal	 = is_odd ? varying.out_normal: varying.in_normal;
+	vec2* out_uv		 = is_odd ? varying.out_uv: varying.in_uv;
 
 	// tranverse all the edges from first vertex
 	for (int i = 0; i < num_vert; i++)
@@ -157,33 +234,33 @@ static int clip_with_plane(clip_plane c_plane, int num_vert, payload_t &payload)
 	return out_vert_num;
 }
 
-static int homo_clipping(payload_t &payload)
+int homo_clipping(varying_t &varying)
 {
 	int num_vertex = 3;
-	num_vertex = clip_with_plane(W_PLANE, num_vertex, payload);
-	num_vertex = clip_with_plane(X_RIGHT, num_vertex, payload);
-	num_vertex = clip_with_plane(X_LEFT, num_vertex, payload);
-	num_vertex = clip_with_plane(Y_TOP, num_vertex, payload);
-	num_vertex = clip_with_plane(Y_BOTTOM, num_vertex, payload);
-	num_vertex = clip_with_plane(Z_NEAR, num_vertex, payload);
-	num_vertex = clip_with_plane(Z_FAR, num_vertex, payload);
+	num_vertex = clip_with_plane(W_PLANE, num_vertex, varying);
+	num_vertex = clip_with_plane(X_RIGHT, num_vertex, varying);
+	num_vertex = clip_with_plane(X_LEFT, num_vertex, varying);
+	num_vertex = clip_with_plane(Y_TOP, num_vertex, varying);
+	num_vertex = clip_with_plane(Y_BOTTOM, num_vertex, varying);
+	num_vertex = clip_with_plane(Z_NEAR, num_vertex, varying);
+	num_vertex = clip_with_plane(Z_FAR, num_vertex, varying);
 	return num_vertex;
 }
 
-static void transform_attri(payload_t &payload,int index0,int index1,int index2)
+static void transform_attri(varying_t &varying,int index0,int index1,int index2)
 {
-	payload.clipcoord_attri[0]	= payload.out_clipcoord[index0];
-	payload.clipcoord_attri[1]	= payload.out_clipcoord[index1];
-	payload.clipcoord_attri[2]	= payload.out_clipcoord[index2];
-	payload.worldcoord_attri[0] = payload.out_worldcoord[index0];
-	payload.worldcoord_attri[1] = payload.out_worldcoord[index1];
-	payload.worldcoord_attri[2] = payload.out_worldcoord[index2];
-	payload.normal_attri[0]		= payload.out_normal[index0];
-	payload.normal_attri[1]		= payload.out_normal[index1];
-	payload.normal_attri[2]		= payload.out_normal[index2];
-	payload.uv_attri[0]			= payload.out_uv[index0];
-	payload.uv_attri[1]			= payload.out_uv[index1];
-	payload.uv_attri[2]			= payload.out_uv[index2];
+	varying.clipcoord_attri[0]	= varying.out_clipcoord[index0];
+	varying.clipcoord_attri[1]	= varying.out_clipcoord[index1];
+	varying.clipcoord_attri[2]	= varying.out_clipcoord[index2];
+	varying.worldcoord_attri[0] = varying.out_worldcoord[index0];
+	varying.worldcoord_attri[1] = varying.out_worldcoord[index1];
+	varying.worldcoord_attri[2] = varying.out_worldcoord[index2];
+	varying.normal_attri[0]		= varying.out_normal[index0];
+	varying.normal_attri[1]		= varying.out_normal[index1];
+	varying.normal_attri[2]		= varying.out_normal[index2];
+	varying.uv_attri[0]			= varying.out_uv[index0];
+	varying.uv_attri[1]			= varying.out_uv[index1];
+	varying.uv_attri[2]			= varying.out_uv[index2];
 }
 //drawline
 //void drawline(int x0, int y0, int x1, int y1, unsigned char* framebuffer)
@@ -340,14 +417,12 @@ void rasterize_wireframe(vector<vec3> &triangle, TGAImage &image)
 }
 */
 
-void rasterize_singlethread(vec4 *clipcoord_attri, unsigned char *framebuffer, float *zbuffer, IShader &shader)
+// homogeneous division, viewport transformation, backface culling and bounding box,
+// return 0 if the triangle is culled
+static int setup_triangle(const vec4 *clipcoord_attri, int is_skybox, int width, int height, vec3 screen_pos[3],
+	float bbox[4], draw_counters_t &counters)
 {
 	vec3 ndc_pos[3];
-	vec3 screen_pos[3];
-	unsigned char c[3];
-	int width  = window->width;
-	int height = window->height;
-	int is_skybox = shader.payload.model->is_skybox;
 
 	// homogeneous division
 	for (int i = 0; i < 3; i++)
@@ -369,7 +444,10 @@ void rasterize_singlethread(vec4 *clipcoord_attri, unsigned char *framebuffer, f
 	if (!is_skybox)
 	{
 		if (is_back_facing(ndc_pos))
-			return;
+		{
+			counters.backface_culled++;
+			return 0;
+		}
 	}
 
 	// get bounding box
@@ -381,157 +459,649 @@ void rasterize_singlethread(vec4 *clipcoord_attri, unsigned char *framebuffer, f
 		ymin = float_min(ymin, screen_pos[i][1]);
 		ymax = float_max(ymax, screen_pos[i][1]);
 	}
+	bbox[0] = xmin; bbox[1] = xmax;
+	bbox[2] = ymin; bbox[3] = ymax;
+	counters.rasterized++;
+	return 1;
+}
+
+// the fragment counts are kept in locals, the framebuffer writes would force them to memory
+static void rasterize_serial(const varying_t &varying, int width, int height, unsigned char *framebuffer, float *zbuffer,
+	const IShader &shader, draw_counters_t &counters)
+{
+	const vec4 *clipcoord_attri = varying.clipcoord_attri;
+	vec3 screen_pos[3];
+	float bbox[4];
+	unsigned char c[3];
+	int num_fragments = 0, num_shaded = 0;
+
+	if (!setup_triangle(clipcoord_attri, shader.payload.model->is_skybox, width, height, screen_pos, bbox, counters))
+		return;
 
 	// rasterization
-	for (int x = (int)xmin; x <= (int)xmax; x++)
+	for (int x = (int)bbox[0]; x <= (int)bbox[1]; x++)
 	{
-		for (int y = (int)ymin; y <= (int)ymax; y++)
+		for (int y = (int)bbox[2]; y <= (int)bbox[3]; y++)
 		{
 			vec3 barycentric = compute_barycentric2D((float)(x + 0.5), (float)(y + 0.5), screen_pos);
 			float alpha = barycentric.x(); float beta = barycentric.y(); float gamma = barycentric.z();
 
 			if (is_inside_triangle(alpha, beta, gamma))
 			{
-				int index = get_index(x, y);
+				int index = get_index(width, height, x, y);
 				//interpolation correct term
 				float normalizer = 1.0 / (alpha / clipcoord_attri[0].w() + beta / clipcoord_attri[1].w() + gamma / clipcoord_attri[2].w());
 				//for larger z means away from camera, needs to interpolate z-value as a property			
 				float z = (alpha * screen_pos[0].z() / clipcoord_attri[0].w() + beta * screen_pos[1].z() / clipcoord_attri[1].w() +
 					gamma * screen_pos[2].z() / clipcoord_attri[2].w()) * normalizer;
 
+				num_fragments++;
 				if (zbuffer[index] > z)
 				{
 					zbuffer[index] = z;
-					vec3 color = shader.fragment_shader(alpha, beta, gamma);
+					vec3 color = shader.fragment_shader(varying, alpha, beta, gamma);
+					num_shaded++;
 
 					//clamp color value
 					for (int i = 0; i < 3; i++)
 					{
 						c[i] = (int)float_clamp(color[i], 0, 255);
 					}
-					set_color(framebuffer, x, y, c);
+					set_color(framebuffer, width, height, x, y, c);
 				}
 			}
 		}
 	}
+
+	counters.fragments += num_fragments;
+	counters.depth_failed += num_fragments - num_shaded;
+	counters.shaded += num_shaded;
 }
 
-/*
-void rasterize_multithread(vec4 *clipcoord_attri, unsigned char* framebuffer, float *zbuffer, IShader& shader)
+void rasterize_singlethread(const varying_t &varying, int width, int height, unsigned char *framebuffer, float *zbuffer,
+	const IShader &shader)
 {
-	vec3 ndc_pos[3];
-	vec3 screen_pos[3];
+	draw_counters_t counters = {};
+	rasterize_serial(varying, width, height, framebuffer, zbuffer, shader, counters);
+}
+
+// the depth is positive, so its bits compare like unsigned integers and the smallest packed
+// value is the nearest fragment. fragments at the same depth resolve to the smaller color,
+// the result does not depend on which thread came first
+static inline unsigned long long pack_pixel(float depth, const unsigned char c[3])
+{
+	unsigned int depth_bits;
+	memcpy(&depth_bits, &depth, sizeof(float));
+	unsigned int color = c[0] | (c[1] << 8) | (c[2] << 16);
+	return ((unsigned long long)depth_bits << 32) | color;
+}
+
+static inline float unpack_depth(unsigned long long pixel)
+{
+	unsigned int depth_bits = (unsigned int)(pixel >> 32);
+	float depth;
+	memcpy(&depth, &depth_bits, sizeof(float));
+	return depth;
+}
+
+// rasterize a triangle that passed setup_triangle into the packed buffer
+static void rasterize_packed(const varying_t &varying, const vec3 screen_pos[3], const float bbox[4],
+	int width, int height, packed_pixel_t *buffer, const IShader &shader, draw_counters_t &counters)
+{
+	const vec4 *clipcoord_attri = varying.clipcoord_attri;
 	unsigned char c[3];
-	int width = window->width;
-	int height = window->height;
-	int i = 0, j = 0, flag = 0;
+	int num_fragments = 0, num_shaded = 0;
 
-	//Homogeneous division
-	for (i = 0; i < 3; i++)
+	// rasterization
+	for (int x = (int)bbox[0]; x <= (int)bbox[1]; x++)
 	{
-		//simple clip
-		if (clipcoord_attri[i].w() > -0.1f)
-			flag = 1;
+		for (int y = (int)bbox[2]; y <= (int)bbox[3]; y++)
+		{
+			vec3 barycentric = compute_barycentric2D((float)(x + 0.5), (float)(y + 0.5), screen_pos);
+			float alpha = barycentric.x(); float beta = barycentric.y(); float gamma = barycentric.z();
+
+			if (is_inside_triangle(alpha, beta, gamma))
+			{
+				int index = get_index(width, height, x, y);
+				//interpolation correct term
+				float normalizer = 1.0 / (alpha / clipcoord_attri[0].w() + beta / clipcoord_attri[1].w() + gamma / clipcoord_attri[2].w());
+				//for larger z means away from camera, needs to interpolate z-value as a property
+				float z = (alpha * screen_pos[0].z() / clipcoord_attri[0].w() + beta * screen_pos[1].z() / clipcoord_attri[1].w() +
+					gamma * screen_pos[2].z() / clipcoord_attri[2].w()) * normalizer;
 
-		ndc_pos[i][0] = clipcoord_attri[i][0] /= clipcoord_attri[i].w();
-		ndc_pos[i][1] = clipcoord_attri[i][1] /= clipcoord_attri[i].w();
-		ndc_pos[i][2] = clipcoord_attri[i][2] /= clipcoord_attri[i].w();
+				// early depth test, then shade and keep the nearest value with a compare-and-swap min.
+				// no lock is taken, a failed swap only retries against the newer value
+				num_fragments++;
+				unsigned long long old_pixel = buffer[index].load(std::memory_order_relaxed);
+				if (unpack_depth(old_pixel) <= z)
+					continue;
+
+				vec3 color = shader.fragment_shader(varying, alpha, beta, gamma);
+				num_shaded++;
+
+				//clamp color value
+				for (int i = 0; i < 3; i++)
+				{
+					c[i] = (int)float_clamp(color[i], 0, 255);
+				}
+				unsigned long long new_pixel = pack_pixel(z, c);
+				while (new_pixel < old_pixel &&
+					!buffer[index].compare_exchange_weak(old_pixel, new_pixel, std::memory_order_relaxed))
+					;
+			}
+		}
 	}
 
-	//viewport transform
-	for (i = 0; i < 3; i++)
+	counters.fragments += num_fragments;
+	counters.depth_failed += num_fragments - num_shaded;
+	counters.shaded += num_shaded;
+}
+
+static void rasterize_setup_packed(const varying_t &varying, int width, int height, packed_pixel_t *buffer,
+	const IShader &shader, draw_counters_t &counters)
+{
+	vec3 screen_pos[3];
+	float bbox[4];
+	if (setup_triangle(varying.clipcoord_attri, shader.payload.model->is_skybox, width, height, screen_pos, bbox, counters))
+		rasterize_packed(varying, screen_pos, bbox, width, height, buffer, shader, counters);
+}
+
+void rasterize_multithread(const varying_t &varying, int width, int height, packed_pixel_t *buffer, const IShader &shader)
+{
+	draw_counters_t counters = {};
+	rasterize_setup_packed(varying, width, height, buffer, shader, counters);
+}
+
+void clear_packed_buffer(int width, int height, packed_pixel_t *buffer)
+{
+	TRACE_SCOPE("clear_packed_buffer");
+	unsigned char background[3] = { 0, 0, 0 };
+	unsigned long long clear_value = pack_pixel(ZBUFFER_FAR, background);
+	for (int i = 0; i < width * height; i++)
+		buffer[i].store(clear_value, std::memory_order_relaxed);
+}
+
+void resolve_packed_buffer(int width, int height, const packed_pixel_t *buffer, unsigned char *framebuffer, float *zbuffer)
+{
+	TRACE_SCOPE("resolve_packed_buffer");
+	// pixels no fragment reached keep the cleared framebuffer and zbuffer
+	for (int i = 0; i < width * height; i++)
 	{
-		screen_pos[i][0] = 0.5*width*(ndc_pos[i][0] + 1.0);
-		screen_pos[i][1] = 0.5*height*(ndc_pos[i][1] + 1.0);
-		screen_pos[i][2] = -clipcoord_attri[i].w();
+		unsigned long long pixel = buffer[i].load(std::memory_order_relaxed);
+		float depth = unpack_depth(pixel);
+		if (depth >= ZBUFFER_FAR)
+			continue;
 
-		//simple clip
-		if (screen_pos[i][0] < 0 || screen_pos[i][0]>width
-			|| screen_pos[i][1]<0 || screen_pos[i][1]>height)
-			flag = 1;
+		zbuffer[i] = depth;
+		for (int k = 0; k < 3; k++)
+			framebuffer[i * 4 + k] = (unsigned char)(pixel >> (8 * k));
 	}
+}
 
-	//check clip condition
-	if (flag)
-		return;
 
-	//backface clip
-	if (is_back_facing(ndc_pos))
-		return;
+// fetch the shaded vertices of a face and clip it, return the number of vertices of the polygon
+static int clip_face(const draw_context_t &context, const IShader &shader, varying_t &varying, int nface,
+	draw_counters_t &counters)
+{
+	const unsigned int *face = shader.payload.model->face(nface);
+	for (int i = 0; i < 3; i++)
+	{
+		const vertex_out_t &vertex = context.vertex_buffer[face[i]];
+		varying.in_clipcoord[i]  = vertex.clipcoord;
+		varying.in_worldcoord[i] = vertex.worldcoord;
+		varying.in_normal[i]	 = vertex.normal;
+		varying.in_uv[i]		 = vertex.uv;
+	}
 
-	//bounding box
-	float xmin = 10000, xmax = -10000, ymin = 10000, ymax = -10000;
-	for (i = 0; i < 3; i++) {
-		xmin = float_min(xmin, screen_pos[i][0]);
-		xmax = float_max(xmax, screen_pos[i][0]);
-		ymin = float_min(ymin, screen_pos[i][1]);
-		ymax = float_max(ymax, screen_pos[i][1]);
+	// homogeneous clipping
+	int num_vertex = homo_clipping(varying);
+	counters.faces++;
+	if (num_vertex < 3)
+		counters.clip_culled++;
+	else
+		counters.triangles += num_vertex - 2;
+	return num_vertex;
+}
+
+static void draw_triangles_serial(const draw_context_t &context, unsigned char *framebuffer, float *zbuffer,
+	const IShader &shader, varying_t &varying, int nface, draw_counters_t &counters)
+{
+	int num_vertex = clip_face(context, shader, varying, nface, counters);
+
+	// triangle assembly and reaterize
+	for (int i = 0; i < num_vertex - 2; i++) {
+		int index0 = 0;
+		int index1 = i + 1;
+		int index2 = i + 2;
+		// transform data to real vertex attri
+		transform_attri(varying, index0, index1, index2);
+
+		rasterize_serial(varying, context.width, context.height, framebuffer, zbuffer, shader, counters);
 	}
+}
+
+void draw_triangles(const draw_context_t &context, unsigned char *framebuffer, float *zbuffer, const IShader &shader, varying_t &varying, int nface)
+{
+	draw_triangles_serial(context, framebuffer, zbuffer, shader, varying, nface, thread_counters(context));
+}
+
+static void draw_triangles_immediate(const draw_context_t &context, packed_pixel_t *buffer, const IShader &shader,
+	varying_t &varying, int nface, draw_counters_t &counters)
+{
+	int num_vertex = clip_face(context, shader, varying, nface, counters);
+
+	for (int i = 0; i < num_vertex - 2; i++)
+	{
+		transform_attri(varying, 0, i + 1, i + 2);
+		rasterize_setup_packed(varying, context.width, context.height, buffer, shader, counters);
+	}
+}
+
+// largest simplification error of the selected level of detail, in pixels
+static const float LOD_PIXEL_ERROR = 1.0f;
+
+static int select_lod(const payload_t &payload, int height)
+{
+	// pixels covered by one model space unit at the nearest point of the bounding sphere
+	Model *model = payload.model;
+	float distance = (payload.camera->eye - model->bsphere_center).norm() - model->bsphere_radius;
+	if (distance <= 0)
+		return 0;
+	float pixels_per_unit = fabs(payload.camera_perp_matrix[1][1]) * height * 0.5f / distance;
 
-	//rasterization
-	for (int x = (int)xmin; x <= (int)xmax; x++)
+	int lod = 0;
+	for (int i = 1; i < model->nlods(); i++)
 	{
-		for (int y = (int)ymin; y <= (int)ymax; y++)
+		if (model->lod(i).error * pixels_per_unit <= LOD_PIXEL_ERROR)
+			lod = i;
+	}
+	return lod;
+}
+
+int lod_face_count(const draw_context_t *context, const IShader &shader)
+{
+	const payload_t &payload = shader.payload;
+	return payload.model->lod(select_lod(payload, context->height)).face_count;
+}
+
+// cull and sort the meshlets of the selected level of detail into visible_meshlets and shade
+// their vertices into vertex_buffer
+static void prepare_model(draw_context_t &context, const IShader &shader, const occlusion_buffer_t *occlusion)
+{
+	TRACE_SCOPE("prepare_model");
+	std::vector<vertex_out_t> &vertex_buffer = context.vertex_buffer;
+	std::vector<unsigned int> &vertex_stamp = context.vertex_stamp;
+	std::vector<unsigned int> &shaded_vertices = context.shaded_vertices;
+	std::vector<meshlet_draw_t> &visible_meshlets = context.visible_meshlets;
+	unsigned int &draw_stamp = context.draw_stamp;
+	const payload_t &payload = shader.payload;
+	Model *model = payload.model;
+	int num_verts = model->nverts();
+	const mesh_lod_t &lod = model->lod(select_lod(payload, context.height));
+
+	// cull whole meshlets against the frustum and, except for the skybox, by their normal cone
+	// and the occlusion buffer
+	vec4 planes[6];
+	frustum_planes(payload.mvp_matrix, planes);
+	visible_meshlets.clear();
+	for (int i = lod.meshlet_offset; i < lod.meshlet_offset + lod.meshlet_count; i++)
+	{
+		const meshlet_t &meshlet = model->meshlet(i);
+		if (meshlet_is_culled(meshlet, planes, payload.camera->eye, !model->is_skybox))
+			continue;
+		if (occlusion && !occlusion_test_sphere(occlusion, payload.mvp_matrix, meshlet.center, meshlet.radius))
+			continue;
+		meshlet_draw_t draw = { i, sphere_view_depth(payload.mvp_matrix, meshlet.center, meshlet.radius) };
+		visible_meshlets.push_back(draw);
+	}
+
+	// front to back, so near meshlets fill the zbuffer first and hidden fragments fail the depth test
+	std::sort(visible_meshlets.begin(), visible_meshlets.end(),
+		[](const meshlet_draw_t &a, const meshlet_draw_t &b) { return a.depth < b.depth; });
+
+	// vertex shader, every vertex of a visible meshlet is shaded once no matter how many faces share it
+	if ((int)vertex_buffer.size() < num_verts)
+	{
+		vertex_buffer.resize(num_verts);
+		vertex_stamp.resize(num_verts, 0);
+	}
+	if (++draw_stamp == 0)
+	{
+		std::fill(vertex_stamp.begin(), vertex_stamp.end(), 0);
+		draw_stamp = 1;
+	}
+	shaded_vertices.clear();
+	for (size_t m = 0; m < visible_meshlets.size(); m++)
+	{
+		const meshlet_t &meshlet = model->meshlet(visible_meshlets[m].index);
+		const unsigned int *indices = model->face(meshlet.face_offset);
+		for (int i = 0; i < meshlet.face_count * 3; i++)
 		{
-			vec3 result = compute_barycentric2D((float)(x + 0.5), (float)(y + 0.5), screen_pos);
-			float alpha = result.x(); float beta = result.y(); float gamma = result.z();
+			unsigned int v = indices[i];
+			if (vertex_stamp[v] != draw_stamp)
+			{
+				vertex_stamp[v] = draw_stamp;
+				shaded_vertices.push_back(v);
+			}
+		}
+	}
 
-			if (is_inside_triangle(alpha, beta, gamma))
+	// one slot per thread that can run a job of this draw
+	if ((int)context.thread_counters.size() < job_system_num_threads())
+		context.thread_counters.resize(job_system_num_threads(), thread_counters_t());
+	draw_counters_t &counters = thread_counters(context);
+	counters.models++;
+	counters.meshlets += visible_meshlets.size();
+	counters.vertices += shaded_vertices.size();
+
+	// the vertex shaders are const and only read the payload, so the unique vertices are shaded in parallel
+	parallel_for(0, (int)shaded_vertices.size(), VERTEX_JOB_SIZE, [&shader, &vertex_buffer, &shaded_vertices](int begin, int end)
+	{
+		TRACE_SCOPE("vertex_shader");
+		for (int i = begin; i < end; i++)
+			shader.vertex_shader(shaded_vertices[i], vertex_buffer[shaded_vertices[i]]);
+	});
+}
+
+draw_context_t *create_draw_context(int width, int height)
+{
+	draw_context_t *context = new draw_context_t();
+	context->width = width;
+	context->height = height;
+	return context;
+}
+
+void destroy_draw_context(draw_context_t *context)
+{
+	delete context;
+}
+
+draw_counters_t draw_context_counters(const draw_context_t *context)
+{
+	draw_counters_t total = {};
+	for (size_t i = 0; i < context->thread_counters.size(); i++)
+		add_draw_counters(total, context->thread_counters[i].counters);
+	return total;
+}
+
+void reset_draw_counters(draw_context_t *context)
+{
+	for (size_t i = 0; i < context->thread_counters.size(); i++)
+		context->thread_counters[i].counters = draw_counters_t();
+}
+
+void add_draw_counters(draw_counters_t &total, const draw_counters_t &counters)
+{
+	total.models			+= counters.models;
+	total.meshlets			+= counters.meshlets;
+	total.vertices			+= counters.vertices;
+	total.faces				+= counters.faces;
+	total.clip_culled		+= counters.clip_culled;
+	total.triangles			+= counters.triangles;
+	total.backface_culled	+= counters.backface_culled;
+	total.rasterized		+= counters.rasterized;
+	total.fragments			+= counters.fragments;
+	total.depth_failed		+= counters.depth_failed;
+	total.shaded			+= counters.shaded;
+}
+
+void draw_model(draw_context_t *context, unsigned char *framebuffer, float *zbuffer, const IShader &shader,
+	const occlusion_buffer_t *occlusion)
+{
+	prepare_model(*context, shader, occlusion);
+
+	// triangle assembly, clipping and rasterization
+	Model *model = shader.payload.model;
+	draw_counters_t &counters = thread_counters(*context);
+	varying_t varying;
+	for (size_t m = 0; m < context->visible_meshlets.size(); m++)
+	{
+		const meshlet_t &meshlet = model->meshlet(context->visible_meshlets[m].index);
+		for (int i = meshlet.face_offset; i < meshlet.face_offset + meshlet.face_count; i++)
+			draw_triangles_serial(*context, framebuffer, zbuffer, shader, varying, i, counters);
+	}
+}
+
+// take the next range of the sorted meshlets, return 0 when all are taken
+static int take_meshlets(pipelined_draw_t &draw, int &begin, int &end)
+{
+	int count = (int)draw.context->visible_meshlets.size();
+	begin = draw.next_meshlet.fetch_add(MESHLET_JOB_SIZE, std::memory_order_relaxed);
+	if (begin >= count)
+		return 0;
+	end = std::min(begin + MESHLET_JOB_SIZE, count);
+	return 1;
+}
+
+// pop one batch from any of the queues and rasterize it, return 0 if all of them were empty
+static int raster_batch(pipelined_draw_t &draw, int first_queue)
+{
+	for (int k = 0; k < draw.num_queues; k++)
+	{
+		triangle_queue_t &queue = *draw.context->triangle_queues[(first_queue + k) % draw.num_queues];
+		unsigned int ticket;
+		triangle_batch_t *batch = queue.begin_pop(ticket);
+		if (batch == NULL)
+			continue;
+
+		draw_counters_t &counters = thread_counters(*draw.context);
+		varying_t varying;
+		for (int i = 0; i < batch->count; i++)
+		{
+			const raster_triangle_t &triangle = batch->triangles[i];
+			for (int j = 0; j < 3; j++)
 			{
-				int index = get_index(x, y);
-				//interpolation correct term
-				float normalizer = 1.0 / (alpha / clipcoord_attri[0].w() + beta / clipcoord_attri[1].w() + gamma / clipcoord_attri[2].w());
-				//for larger z means away from camera, needs to interpolate z-value as a property
-				float z = (alpha*screen_pos[0].z() / clipcoord_attri[0].w() + beta * screen_pos[1].z() / clipcoord_attri[1].w() +
-					gamma * screen_pos[2].z() / clipcoord_attri[2].w()) * normalizer;
+				varying.clipcoord_attri[j]	= triangle.clipcoord[j];
+				varying.worldcoord_attri[j] = triangle.worldcoord[j];
+				varying.normal_attri[j]		= triangle.normal[j];
+				varying.uv_attri[j]			= triangle.uv[j];
+			}
+			rasterize_packed(varying, triangle.screen_pos, triangle.bbox, draw.context->width, draw.context->height, draw.buffer,
+				*draw.shader, counters);
+		}
+		queue.end_pop(ticket);
+		return 1;
+	}
+	return 0;
+}
 
-				if (zbuffer[index] > z)
+static triangle_batch_t *begin_batch(pipelined_draw_t &draw, int queue_index)
+{
+	// the queue is full, help the raster stage instead of waiting for it
+	triangle_batch_t *batch;
+	while ((batch = draw.context->triangle_queues[queue_index]->begin_push()) == NULL)
+	{
+		if (!raster_batch(draw, queue_index))
+			std::this_thread::yield();
+	}
+	batch->count = 0;
+	return batch;
+}
+
+// vertex fetch, clipping and triangle setup of the meshlets, the setup triangles are pushed in batches
+static void geometry_stage(pipelined_draw_t &draw, int queue_index)
+{
+	TRACE_SCOPE("geometry_stage");
+	// counted once running, a raster worker never waits for a geometry job still queued behind it
+	draw.active_producers.fetch_add(1, std::memory_order_acq_rel);
+	const draw_context_t &context = *draw.context;
+	triangle_queue_t &queue = *context.triangle_queues[queue_index];
+	const IShader &shader = *draw.shader;
+	Model *model = shader.payload.model;
+	draw_counters_t &counters = thread_counters(context);
+	triangle_batch_t *batch = NULL;
+	varying_t varying;
+	int begin, end;
+
+	while (take_meshlets(draw, begin, end))
+	{
+		for (int m = begin; m < end; m++)
+		{
+			const meshlet_t &meshlet = model->meshlet(context.visible_meshlets[m].index);
+			for (int i = meshlet.face_offset; i < meshlet.face_offset + meshlet.face_count; i++)
+			{
+				int num_vertex = clip_face(context, shader, varying, i, counters);
+				for (int k = 0; k < num_vertex - 2; k++)
 				{
-					zbuffer[index] = z;
-					vec3 color = shader.fragment_shader(alpha, beta, gamma);
+					transform_attri(varying, 0, k + 1, k + 2);
+					if (batch == NULL)
+						batch = begin_batch(draw, queue_index);
 
-					//clamp color value
-					for (i = 0; i < 3; i++)
+					raster_triangle_t &triangle = batch->triangles[batch->count];
+					if (!setup_triangle(varying.clipcoord_attri, model->is_skybox, context.width, context.height,
+						triangle.screen_pos, triangle.bbox, counters))
+						continue;
+					for (int j = 0; j < 3; j++)
 					{
-						c[i] = (int)float_clamp(color[i], 0, 255);
-						//c[i] = 200;
+						triangle.clipcoord[j]  = varying.clipcoord_attri[j];
+						triangle.worldcoord[j] = varying.worldcoord_attri[j];
+						triangle.normal[j]	   = varying.normal_attri[j];
+						triangle.uv[j]		   = varying.uv_attri[j];
 					}
-
-					//use spainlock to check whether really need to write the color into buffer and if needed, rewrite the z-value also.
-					//this is for prevent writing conflict
-					sp.lock();
-					if (zbuffer[index] > z - EPSILON)
+					if (++batch->count == TRIANGLE_BATCH_SIZE)
 					{
-						zbuffer[index] = z;
-						set_color(framebuffer, x, y, c);
+						queue.end_push();
+						batch = NULL;
 					}
-					sp.unlock();
 				}
 			}
 		}
 	}
+
+	if (batch != NULL)
+		queue.end_push();
+	draw.active_producers.fetch_sub(1, std::memory_order_release);
 }
-*/
 
-void draw_triangles(unsigned char *framebuffer, float *zbuffer, IShader &shader, int nface)
+// rasterize queued batches until every running producer is done and the queues are drained.
+// when nothing is queued, meshlets no geometry worker has taken yet are drawn directly, so a
+// raster worker never idles while there is work and a draw finishes even on one thread. a
+// geometry job that starts after a raster worker left finds no meshlets or drains its own queue
+static void raster_stage(pipelined_draw_t &draw, int first_queue)
 {
-	// vertex shader
-	for (int i = 0; i < 3; i++)
+	TRACE_SCOPE("raster_stage");
+	const draw_context_t &context = *draw.context;
+	const IShader &shader = *draw.shader;
+	Model *model = shader.payload.model;
+	draw_counters_t &counters = thread_counters(context);
+	varying_t varying;
+	int begin, end;
+
+	for (;;)
 	{
-		shader.vertex_shader(nface, i);
+		// read before the queues are checked, the last batches are pushed before the count drops
+		int producing = draw.active_producers.load(std::memory_order_acquire);
+		if (raster_batch(draw, first_queue))
+			continue;
+
+		if (take_meshlets(draw, begin, end))
+		{
+			for (int m = begin; m < end; m++)
+			{
+				const meshlet_t &meshlet = model->meshlet(context.visible_meshlets[m].index);
+				for (int i = meshlet.face_offset; i < meshlet.face_offset + meshlet.face_count; i++)
+					draw_triangles_immediate(context, draw.buffer, shader, varying, i, counters);
+			}
+			continue;
+		}
+
+		if (producing == 0)
+			return;
+		std::this_thread::yield();
 	}
+}
 
-	// homogeneous clipping
-	int num_vertex = homo_clipping(shader.payload);
+void draw_model_pipelined(draw_context_t *context, packed_pixel_t *buffer, const IShader &shader,
+	const occlusion_buffer_t *occlusion)
+{
+	prepare_model(*context, shader, occlusion);
 
-	// triangle assembly and reaterize
-	for (int i = 0; i < num_vertex - 2; i++) {
-		int index0 = 0;
-		int index1 = i + 1;
-		int index2 = i + 2;
-		// transform data to real vertex attri
-		transform_attri(shader.payload, index0, index1, index2);
+	// half of the threads run the geometry stage and join the raster stage once it is done
+	int num_threads = job_system_num_threads();
+	int num_geometry = (num_threads + 1) / 2;
+	int num_raster = num_threads - num_geometry;
+	std::vector<std::unique_ptr<triangle_queue_t>> &triangle_queues = context->triangle_queues;
+	while ((int)triangle_queues.size() < num_geometry)
+		triangle_queues.emplace_back(new triangle_queue_t());
+	for (int i = 0; i < num_geometry; i++)
+		triangle_queues[i]->reset();
+
+	pipelined_draw_t draw;
+	draw.context = context;
+	draw.buffer = buffer;
+	draw.shader = &shader;
+	draw.num_queues = num_geometry;
+	draw.next_meshlet.store(0);
+	draw.active_producers.store(0);
+
+	job_group_t group;
+	for (int i = 0; i < num_geometry; i++)
+	{
+		job_submit(group, [&draw, i]()
+		{
+			geometry_stage(draw, i);
+			raster_stage(draw, i);
+		});
+	}
+	for (int i = 0; i < num_raster; i++)
+		job_submit(group, [&draw, i]() { raster_stage(draw, i); });
+	job_wait(group);
+}
+
+void draw_model_immediate(draw_context_t *context, packed_pixel_t *buffer, const IShader &shader,
+	const occlusion_buffer_t *occlusion)
+{
+	prepare_model(*context, shader, occlusion);
 
-		rasterize_singlethread(shader.payload.clipcoord_attri, framebuffer,zbuffer,shader);
+	// every job rasterizes a disjoint range of the sorted meshlets with its own triangle context
+	Model *model = shader.payload.model;
+	const std::vector<meshlet_draw_t> &visible_meshlets = context->visible_meshlets;
+	parallel_for(0, (int)visible_meshlets.size(), MESHLET_JOB_SIZE, [context, buffer, &shader, model](int begin, int end)
+	{
+		TRACE_SCOPE("draw_meshlets");
+		draw_counters_t &counters = thread_counters(*context);
+		varying_t varying;
+		for (int m = begin; m < end; m++)
+		{
+			const meshlet_t &meshlet = model->meshlet(context->visible_meshlets[m].index);
+			for (int i = meshlet.face_offset; i < meshlet.face_offset + meshlet.face_count; i++)
+				draw_triangles_immediate(*context, buffer, shader, varying, i, counters);
+		}
+	});
+}
+
+void draw_sky(int width, int height, unsigned char *framebuffer, float *zbuffer, const IShader &shader)
+{
+	const payload_t &payload = shader.payload;
+	cubemap_t *environment_map = payload.model->environment_map;
+
+	// the skybox view has no translation, so the direction of a pixel is the world position of
+	// any point on its ray. take the points one unit in front of the camera: they share the ndc
+	// depth nz and a homogeneous w of -1, which makes the direction -inverse_vp * (nx, ny, nz, 1),
+	// a linear function of the pixel that can be stepped along a scanline without a division
+	vec4 unit_depth = payload.camera_perp_matrix * vec4(0, 0, -1, 1);
+	float nz = unit_depth.z() / unit_depth.w();
+	mat4 inverse_vp = payload.mvp_matrix.inverse();
+
+	// same viewport transformation as the rasterizer, pixel centers are at x + 0.5
+	float ndc_dx = 2.0f / (width - 1);
+	float ndc_dy = 2.0f / (height - 1);
+	vec4 step = inverse_vp * vec4(-ndc_dx, 0, 0, 0);
+	unsigned char c[3];
+
+	for (int y = 0; y < height; y++)
+	{
+		float ny = (y + 0.5f) * ndc_dy - 1.0f;
+		vec4 direction = inverse_vp * vec4(-(0.5f * ndc_dx - 1.0f), -ny, -nz, -1);
+		for (int x = 0; x < width; x++, direction = direction + step)
+		{
+			if (zbuffer[get_index(width, height, x, y)] < ZBUFFER_FAR)
+				continue;
+
+			vec3 color = cubemap_sampling(vec3(direction.x(), direction.y(), direction.z()), environment_map) * 255.f;
+			for (int i = 0; i < 3; i++)
+				c[i] = (int)float_clamp(color[i], 0, 255);
+			set_color(framebuffer, width, height, x, y, c);
+		}
 	}
 }
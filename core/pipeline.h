@@ -1,14 +1,74 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "./macro.h"
 #include "./maths.h"
+#include "./occlusion.h"
 #include "./spainlock.hpp"
 #include "../shader/shader.h"
-#include "../platform/win32.h"
 
+//default size of the window, the pipeline draws at the size given to its draw context
 const int WINDOW_HEIGHT = 600;
 const int WINDOW_WIDTH = 800;
+//clear value of the zbuffer, pixels still at this depth are not covered by any model
+const float ZBUFFER_FAR = 100000;
+
+//depth and color of one pixel packed into a word, so threads drawing at the same time can
+//resolve the depth test with one atomic compare-and-swap instead of a lock
+typedef std::atomic<unsigned long long> packed_pixel_t;
+
+//buffers a draw keeps between its stages. draws with different contexts can run at the same
+//time, e.g. one frame per worker, while a context is only used by one draw at a time
+typedef struct draw_context draw_context_t;
+//width and height are the size of the buffers the draws of the context render into
+draw_context_t *create_draw_context(int width, int height);
+void destroy_draw_context(draw_context_t *context);
+
+//work done by the draws of a context since its counters were reset. every thread counts into
+//its own slot of the context, draw_context_counters adds the slots up
+typedef struct
+{
+	long long models;
+	long long meshlets;			//meshlets left after culling
+	long long vertices;			//vertices of those meshlets run through the vertex shader
+	long long faces;			//faces of those meshlets sent to clipping
+	long long clip_culled;		//faces entirely outside the view volume
+	long long triangles;		//triangles out of clipping, a clipped face can give several
+	long long backface_culled;	//triangles dropped by the backface test
+	long long rasterized;
+	long long fragments;		//pixels inside a rasterized triangle
+	long long depth_failed;		//fragments behind the zbuffer, rejected before shading
+	long long shaded;			//fragment shader invocations
+} draw_counters_t;
+draw_counters_t draw_context_counters(const draw_context_t *context);
+void reset_draw_counters(draw_context_t *context);
+void add_draw_counters(draw_counters_t &total, const draw_counters_t &counters);
+
+//kernels of the rasterizer, public for the microbenchmarks.
+//homo_clipping clips the triangle in varying.in_xxx against the view volume into varying.out_xxx
+//and returns the number of vertices of the polygon
+int homo_clipping(varying_t &varying);
+vec3 compute_barycentric2D(float x, float y, const vec3* v);
+int is_inside_triangle(float alpha, float beta, float gamma);
 
 //rasterize triangle
-void rasterize_singlethread(vec4 *clipcoord_attri, unsigned char* framebuffer, float *zbuffer, IShader& shader);
-void rasterize_multithread(vec4 *clipcoord_attri, unsigned char* framebuffer, float *zbuffer, IShader& shader);
-void draw_triangles(unsigned char* framebuffer, float *zbuffer,IShader& shader,int nface);
\ No newline at end of file
+void rasterize_singlethread(const varying_t &varying, int width, int height, unsigned char* framebuffer, float *zbuffer, const IShader& shader);
+void rasterize_multithread(const varying_t &varying, int width, int height, packed_pixel_t *buffer, const IShader& shader);
+//draw_triangles reads the vertices shaded by draw_model, so it is only valid inside a draw.
+//the shader is shared, every thread passes its own varying as the triangle context
+void draw_triangles(const draw_context_t &context, unsigned char* framebuffer, float *zbuffer,const IShader& shader,varying_t &varying,int nface);
+//occlusion is optional, meshlets hidden behind its occluders are skipped
+void draw_model(draw_context_t *context, unsigned char* framebuffer, float *zbuffer, const IShader& shader, const occlusion_buffer_t *occlusion);
+//immediate mode, the worker threads rasterize disjoint ranges of faces straight into the packed buffer
+void draw_model_immediate(draw_context_t *context, packed_pixel_t *buffer, const IShader& shader, const occlusion_buffer_t *occlusion);
+//pipelined mode, geometry workers clip and set up triangles and hand them in batches to raster workers
+void draw_model_pipelined(draw_context_t *context, packed_pixel_t *buffer, const IShader& shader, const occlusion_buffer_t *occlusion);
+//faces of the level of detail the draws select for payload.model, before any culling
+int lod_face_count(const draw_context_t *context, const IShader& shader);
+void clear_packed_buffer(int width, int height, packed_pixel_t *buffer);
+//copy the covered pixels of the packed buffer into the framebuffer and zbuffer
+void resolve_packed_buffer(int width, int height, const packed_pixel_t *buffer, unsigned char* framebuffer, float *zbuffer);
+//sky pass after all models, fills the pixels still at ZBUFFER_FAR with the environment map of payload.model
+void draw_sky(int width, int height, unsigned char* framebuffer, float *zbuffer, const IShader& shader);
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "./presenter.h"
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./trace.h"
+
+static std::vector<unsigned char *> buffers;
+static std::deque<unsigned char *> free_buffers;
+static std::deque<unsigned char *> ready_buffers;	// submitted, waiting to be presented
+static void (*present_func)(unsigned char *framebuffer) = NULL;
+
+static std::thread presenter;
+static std::mutex present_mutex;
+static std::condition_variable buffer_ready;
+static std::condition_variable buffer_free;
+static bool running = false;
+
+static void presenter_main()
+{
+	trace_thread_name("presenter");
+	std::unique_lock<std::mutex> lock(present_mutex);
+	for (;;)
+	{
+		buffer_ready.wait(lock, [] { return !ready_buffers.empty() || !running; });
+		if (ready_buffers.empty())
+			break;
+
+		unsigned char *framebuffer = ready_buffers.front();
+		ready_buffers.pop_front();
+
+		// the copy into the window and the blit run without the lock, the renderer keeps going
+		lock.unlock();
+		{
+			TRACE_SCOPE("present");
+			present_func(framebuffer);
+		}
+		lock.lock();
+
+		free_buffers.push_back(framebuffer);
+		buffer_free.notify_one();
+	}
+}
+
+void presenter_init(int width, int height, int num_buffers, void (*present)(unsigned char *framebuffer))
+{
+	size_t size = sizeof(unsigned char) * width * height * 4;
+	for (int i = 0; i < num_buffers; i++)
+	{
+		unsigned char *framebuffer = (unsigned char *)malloc(size);
+		memset(framebuffer, 0, size);
+		buffers.push_back(framebuffer);
+		free_buffers.push_back(framebuffer);
+	}
+
+	present_func = present;
+	running = true;
+	presenter = std::thread(presenter_main);
+}
+
+void presenter_shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(present_mutex);
+		running = false;
+	}
+	buffer_ready.notify_one();
+	if (presenter.joinable())
+		presenter.join();
+
+	for (size_t i = 0; i < buffers.size(); i++)
+		free(buffers[i]);
+	buffers.clear();
+	free_buffers.clear();
+	ready_buffers.clear();
+}
+
+unsigned char *presenter_acquire()
+{
+	std::unique_lock<std::mutex> lock(present_mutex);
+	buffer_free.wait(lock, [] { return !free_buffers.empty(); });
+	unsigned char *framebuffer = free_buffers.front();
+	free_buffers.pop_front();
+	return framebuffer;
+}
+
+void presenter_submit(unsigned char *framebuffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(present_mutex);
+		ready_buffers.push_back(framebuffer);
+	}
+	buffer_ready.notify_one();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// presentation on a dedicated thread. the renderer draws into one of a ring of framebuffers
+// while the presenter converts and displays the ones finished before, in submission order
+
+// present is called on the presenter thread, e.g. window_draw
+void presenter_init(int width, int height, int num_buffers, void (*present)(unsigned char *framebuffer));
+// present the framebuffers still queued and stop the thread
+void presenter_shutdown();
+
+// a framebuffer that is neither being drawn nor presented, waits for the presenter if the
+// ring is used up. with three buffers the renderer can hold two frames in flight without waiting
+unsigned char *presenter_acquire();
+// hand a finished framebuffer to the presenter, it returns to the ring once displayed
+void presenter_submit(unsigned char *framebuffer);
@@ -1,6 +1,8 @@
 #include "./sample.h"
+#include <stdio.h>
 #include <stdlib.h>
-#include <thread>
+
+#include "./jobsystem.h"
 using namespace std;
 
 static int cal_cubemap_uv(vec3 direction, vec2&uv)
@@ -202,7 +204,7 @@ void set_normal_coord(int face_id, int x, int y, float &x_coord, float &y_coord,
 }
 
 /* specular part */
-void generate_prefilter_map(int thread_id, int face_id, int mip_level,TGAImage &image)
+void generate_prefilter_map(int face_id, int mip_level,TGAImage &image)
 {
 	int factor = 1;
 	for (int temp = 0; temp < mip_level; temp++)
@@ -214,7 +216,6 @@ void generate_prefilter_map(int thread_id, int face_id, int mip_level,TGAImage &
 	if (width < 64)
 		width = 64;
 
-	int x, y;
 	const char* modelname5[] =
 	{
 		"obj/gun/Cerberus.obj",
@@ -226,133 +227,132 @@ void generate_prefilter_map(int thread_id, int face_id, int mip_level,TGAImage &
 		roughness[i] = i * (1.0 / 9.0);
 	roughness[0] = 0; roughness[9] = 1;
 
-	/* for multi-thread */
-	//int interval = width / thread_num;
-	//int start = thread_id * interval;
-	//int end = (thread_id + 1) * interval;
-	//if (thread_id == thread_num - 1)
-	//	end = width;
-
 	Model *model[1];
 	model[0] = new Model(modelname5[1], 1);
 
 	payload_t p;
 	p.model = model[0];
 
-	vec3 prefilter_color(0, 0, 0);
-	for (x = 0; x < height; x++)
+	// rows are baked in parallel by the job system
+	parallel_for(0, height, 4, [&](int row_begin, int row_end)
 	{
-		for (y = 0; y < width; y++)
+		int x, y;
+		vec3 prefilter_color(0, 0, 0);
+		for (x = row_begin; x < row_end; x++)
 		{
-			float x_coord, y_coord, z_coord;
-			set_normal_coord(face_id, x, y, x_coord, y_coord, z_coord, float(width - 1));
-
-			vec3 normal = vec3(x_coord, y_coord, z_coord);
-			normal = unit_vector(normal);					//z-axis
-			vec3 up = fabs(normal[1]) < 0.999f ? vec3(0.0f, 1.0f, 0.0f) : vec3(0.0f, 0.0f, 1.0f);
-			vec3 right = unit_vector(cross(up, normal));	//x-axis
-			up = cross(normal, right);						//y-axis
-
-			vec3 r = normal;
-			vec3 v = r;
-
-			prefilter_color = vec3(0, 0, 0);
-			float total_weight = 0.0f;
-			int numSamples = 1024;
-			for (int i = 0; i < numSamples; i++)
+			for (y = 0; y < width; y++)
 			{
-				vec2 Xi = hammersley2d(i, numSamples);
-				vec3 h = ImportanceSampleGGX(Xi, normal, roughness[mip_level]);
-				vec3 l = unit_vector(2.0*dot(v, h) * h - v);
-
-				vec3 radiance = cubemap_sampling(l, p.model->environment_map);
-				float n_dot_l = float_max(dot(normal, l), 0.0);
-
-				if (n_dot_l > 0)
+				float x_coord, y_coord, z_coord;
+				set_normal_coord(face_id, x, y, x_coord, y_coord, z_coord, float(width - 1));
+
+				vec3 normal = vec3(x_coord, y_coord, z_coord);
+				normal = unit_vector(normal);					//z-axis
+				vec3 up = fabs(normal[1]) < 0.999f ? vec3(0.0f, 1.0f, 0.0f) : vec3(0.0f, 0.0f, 1.0f);
+				vec3 right = unit_vector(cross(up, normal));	//x-axis
+				up = cross(normal, right);						//y-axis
+
+				vec3 r = normal;
+				vec3 v = r;
+
+				prefilter_color = vec3(0, 0, 0);
+				float total_weight = 0.0f;
+				int numSamples = 1024;
+				for (int i = 0; i < numSamples; i++)
 				{
-					prefilter_color += radiance * n_dot_l;
-					total_weight += n_dot_l;
+					vec2 Xi = hammersley2d(i, numSamples);
+					vec3 h = ImportanceSampleGGX(Xi, normal, roughness[mip_level]);
+					vec3 l = unit_vector(2.0*dot(v, h) * h - v);
+
+					vec3 radiance = cubemap_sampling(l, p.model->environment_map);
+					float n_dot_l = float_max(dot(normal, l), 0.0);
+
+					if (n_dot_l > 0)
+					{
+						prefilter_color += radiance * n_dot_l;
+						total_weight += n_dot_l;
+					}
 				}
-			}
 
-			prefilter_color = prefilter_color / total_weight;
-			//cout << irradiance << endl;
-			int red = float_min(prefilter_color.x() * 255.0f, 255);
-			int green = float_min(prefilter_color.y() * 255.0f, 255);
-			int blue = float_min(prefilter_color.z() * 255.0f, 255);
+				prefilter_color = prefilter_color / total_weight;
+				//cout << irradiance << endl;
+				int red = float_min(prefilter_color.x() * 255.0f, 255);
+				int green = float_min(prefilter_color.y() * 255.0f, 255);
+				int blue = float_min(prefilter_color.z() * 255.0f, 255);
 
-			//cout << irradiance << endl;
-			TGAColor temp(red, green, blue);
-			image.set(x, y, temp);
+				//cout << irradiance << endl;
+				TGAColor temp(red, green, blue);
+				image.set(x, y, temp);
+			}
+			printf("%f% \n", x / 512.0f);
 		}
-		printf("%f% \n", x / 512.0f);
-	}
+	});
+
+	delete model[0];
 }
 
 /* diffuse part */
-void generate_irradiance_map(int thread_id, int face_id,TGAImage &image)
+void generate_irradiance_map(int face_id,TGAImage &image)
 {
-	int x, y;
 	const char* modelname5[] =
 	{
 		"obj/gun/Cerberus.obj",
 		"obj/skybox4/box.obj",
 	};
 
-	/* for multi-thread */
-	//int interval = 256 / thread_num;
-	//int start = thread_id * interval;
-	//int end = (thread_id + 1) * interval;
-	//if (thread_id == thread_num - 1)
-	//	end = 256;
-
 	Model *model[1];
 	model[0] = new Model(modelname5[1], 1);
 
 	payload_t p;
 	p.model = model[0];
 
-	vec3 irradiance(0, 0, 0);
-	for (x = 0; x < 256; x++)
+	// rows are baked in parallel by the job system
+	parallel_for(0, 256, 4, [&](int row_begin, int row_end)
 	{
-		for (y = 0; y < 256; y++)
+		int x, y;
+		vec3 irradiance(0, 0, 0);
+		for (x = row_begin; x < row_end; x++)
 		{
-			float x_coord, y_coord, z_coord;
-			set_normal_coord(face_id, x, y, x_coord, y_coord, z_coord);
-			vec3 normal = unit_vector(vec3(x_coord, y_coord, z_coord));					 //z-axis
-			vec3 up = fabs(normal[1]) < 0.999f ? vec3(0.0f, 1.0f, 0.0f) : vec3(0.0f, 0.0f, 1.0f);
-			vec3 right = unit_vector(cross(up, normal));								 //tagent x-axis
-			up = cross(normal, right);					                                 //tagent y-axis
-
-			irradiance = vec3(0, 0, 0);
-			float sampleDelta = 0.025f;
-			int numSamples = 0;
-			for (float phi = 0.0f; phi < 2.0 * PI; phi += sampleDelta)
+			for (y = 0; y < 256; y++)
 			{
-				for (float theta = 0.0f; theta < 0.5 * PI; theta += sampleDelta)
+				float x_coord, y_coord, z_coord;
+				set_normal_coord(face_id, x, y, x_coord, y_coord, z_coord);
+				vec3 normal = unit_vector(vec3(x_coord, y_coord, z_coord));					 //z-axis
+				vec3 up = fabs(normal[1]) < 0.999f ? vec3(0.0f, 1.0f, 0.0f) : vec3(0.0f, 0.0f, 1.0f);
+				vec3 right = unit_vector(cross(up, normal));								 //tagent x-axis
+				up = cross(normal, right);					                                 //tagent y-axis
+
+				irradiance = vec3(0, 0, 0);
+				float sampleDelta = 0.025f;
+				int numSamples = 0;
+				for (float phi = 0.0f; phi < 2.0 * PI; phi += sampleDelta)
 				{
-					// spherical to cartesian (in tangent space)
-					vec3 tangentSample = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
-					// tangent space to world
-					vec3 sampleVec = tangentSample.x() * right + tangentSample.y() * up + tangentSample.z() * normal;
-					sampleVec = unit_vector(sampleVec);
-					vec3 color = cubemap_sampling(sampleVec, p.model->environment_map);
-
-					irradiance += color * sin(theta) *cos(theta);
-					numSamples++;
+					for (float theta = 0.0f; theta < 0.5 * PI; theta += sampleDelta)
+					{
+						// spherical to cartesian (in tangent space)
+						vec3 tangentSample = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+						// tangent space to world
+						vec3 sampleVec = tangentSample.x() * right + tangentSample.y() * up + tangentSample.z() * normal;
+						sampleVec = unit_vector(sampleVec);
+						vec3 color = cubemap_sampling(sampleVec, p.model->environment_map);
+
+						irradiance += color * sin(theta) *cos(theta);
+						numSamples++;
+					}
 				}
-			}
 
-			irradiance = PI * irradiance * (1.0f / numSamples);
-			int red = float_min(irradiance.x() * 255.0f, 255);
-			int green = float_min(irradiance.y() * 255.0f, 255);
-			int blue = float_min(irradiance.z() * 255.0f, 255);
+				irradiance = PI * irradiance * (1.0f / numSamples);
+				int red = float_min(irradiance.x() * 255.0f, 255);
+				int green = float_min(irradiance.y() * 255.0f, 255);
+				int blue = float_min(irradiance.z() * 255.0f, 255);
 
-			TGAColor temp(red, green, blue);
-			image.set(x, y, temp);
+				TGAColor temp(red, green, blue);
+				image.set(x, y, temp);
+			}
+			printf("%f% \n", x / 256.0f);
 		}
-		printf("%f% \n", x / 256.0f);
-	}
+	});
+
+	delete model[0];
 }
 
 /* lut part */
@@ -432,12 +432,11 @@ void foreach_prefilter_miplevel(TGAImage &image)
 {
 	const char *faces[6] = { "px", "nx", "py", "ny", "pz", "nz" };
 	char paths[6][256];
-	const int thread_num = 4;
 
 	for (int mip_level = 8; mip_level <10; mip_level++)
 	{
 		for (int j = 0; j < 6; j++) {
-			sprintf_s(paths[j], "%s/m%d_%s.tga", "./obj/common2", mip_level,faces[j]);
+			snprintf(paths[j], sizeof(paths[j]), "%s/m%d_%s.tga", "./obj/common2", mip_level,faces[j]);
 		}
 		int factor = 1;
 		for (int temp = 0; temp < mip_level; temp++)
@@ -453,11 +452,7 @@ void foreach_prefilter_miplevel(TGAImage &image)
 		image = TGAImage(w, h, TGAImage::RGB);
 		for (int face_id = 0; face_id < 6; face_id++)
 		{
-			std::thread thread[thread_num];
-			for (int i = 0; i < thread_num; i++)
-				thread[i] = std::thread(generate_prefilter_map, i, face_id,mip_level,std::ref(image));
-			for (int i = 0; i < thread_num; i++)
-				thread[i].join();
+			generate_prefilter_map(face_id, mip_level, image);
 
 			//calculate_BRDF_LUT();
 			image.flip_vertically(); // to place the origin in the bottom left corner of the image
@@ -472,20 +467,15 @@ void foreach_irradiance_map(TGAImage &image)
 {
 	const char *faces[6] = { "px", "nx", "py", "ny", "pz", "nz" };
 	char paths[6][256];
-	const int thread_num = 4;
 
 
 	for (int j = 0; j < 6; j++) {
-		sprintf_s(paths[j], "%s/i_%s.tga", "./obj/common2", faces[j]);
+		snprintf(paths[j], sizeof(paths[j]), "%s/i_%s.tga", "./obj/common2", faces[j]);
 	}
 	image = TGAImage(256, 256, TGAImage::RGB);
 	for (int face_id = 0; face_id < 6; face_id++)
 	{
-		std::thread thread[thread_num];
-		for (int i = 0; i < thread_num; i++)
-			thread[i] = std::thread(generate_irradiance_map, i, face_id, std::ref(image));
-		for (int i = 0; i < thread_num; i++)
-			thread[i].join();
+		generate_irradiance_map(face_id, image);
 
 
 
@@ -1,5 +1,10 @@
 #include "./scene.h"
 
+#include <cstdio>
+#include <cstring>
+
+#include "./trace.h"
+
 TGAImage *texture_from_file(const char *file_name)
 {
 	TGAImage *texture = new TGAImage();
@@ -24,6 +29,7 @@ cubemap_t *cubemap_from_files(const char *positive_x, const char *negative_x,
 
 void load_ibl_map(payload_t &p, const char* env_path)
 {
+	TRACE_SCOPE("load_ibl_map");
 	int i, j;
 	iblmap_t *iblmap = new iblmap_t();
 	const char *faces[6] = { "px", "nx", "py", "ny", "pz", "nz" };
@@ -33,7 +39,7 @@ void load_ibl_map(payload_t &p, const char* env_path)
 
 	/* diffuse environment map */
 	for (j = 0; j < 6; j++) {
-		sprintf_s(paths[j], "%s/i_%s.tga", env_path, faces[j]);
+		snprintf(paths[j], sizeof(paths[j]), "%s/i_%s.tga", env_path, faces[j]);
 	}
 	iblmap->irradiance_map = cubemap_from_files(paths[0], paths[1], paths[2],
 		paths[3], paths[4], paths[5]);
@@ -41,7 +47,7 @@ void load_ibl_map(payload_t &p, const char* env_path)
 	/* specular environment maps */
 	for (i = 0; i < iblmap->mip_levels; i++) {
 		for (j = 0; j < 6; j++) {
-			sprintf_s(paths[j], "%s/m%d_%s.tga", env_path, i, faces[j]);
+			snprintf(paths[j], sizeof(paths[j]), "%s/m%d_%s.tga", env_path, i, faces[j]);
 		}
 		iblmap->prefilter_maps[i] = cubemap_from_files(paths[0], paths[1],
 			paths[2], paths[3], paths[4], paths[5]);
@@ -253,4 +259,34 @@ void build_gun_scene(Model **model, int &m, IShader **shader_use, IShader **shad
 	printf("scene name:%s\n", scene_name);
 	printf("model number:%d\n", m);
 	printf("vertex:%d faces:%d\n", vertex, face);
-}
\ No newline at end of file
+}
+
+static const scene_t Scenes[]
+{
+	{"fuhua",build_fuhua_scene},
+	{"qiyana",build_qiyana_scene},
+	{"yayi",build_yayi_scene},
+	{"xier",build_xier_scene},
+	{"helmet",build_helmet_scene},
+	{"gun",build_gun_scene},
+};
+
+int scene_count()
+{
+	return (int)(sizeof(Scenes) / sizeof(Scenes[0]));
+}
+
+const scene_t *scene_at(int index)
+{
+	return &Scenes[index];
+}
+
+const scene_t *find_scene(const char *scene_name)
+{
+	for (int i = 0; i < scene_count(); i++)
+	{
+		if (strcmp(Scenes[i].scene_name, scene_name) == 0)
+			return &Scenes[i];
+	}
+	return NULL;
+}
@@ -16,4 +16,9 @@ void build_yayi_scene(Model **model, int &m, IShader **shader_use, IShader **sha
 void build_qiyana_scene(Model **model, int &m, IShader **shader_use, IShader **shader_skybox, mat4 perspective, Camera *camera);
 void build_xier_scene(Model **model, int &m, IShader **shader_use, IShader **shader_skybox, mat4 perspective, Camera *camera);
 void build_helmet_scene(Model **model, int &m, IShader **shader_use, IShader **shader_skybox, mat4 perspective, Camera *camera);
-void build_gun_scene(Model **model, int &m, IShader **shader_use, IShader **shader_skybox, mat4 perspective, Camera *camera);
\ No newline at end of file
+void build_gun_scene(Model **model, int &m, IShader **shader_use, IShader **shader_skybox, mat4 perspective, Camera *camera);
+
+// the scenes that can be built, find_scene returns NULL for an unknown name
+int scene_count();
+const scene_t *scene_at(int index);
+const scene_t *find_scene(const char *scene_name);
\ No newline at end of file
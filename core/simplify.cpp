@@ -0,0 +1,241 @@
+#include "./simplify.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+/* quadric error metric */
+// area weighted sum of squared distances to the planes of the faces around a vertex
+typedef struct
+{
+	double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+	double weight;
+} quadric_t;
+
+static void quadric_add_plane(quadric_t &q, const vec3 &n, double d, double weight)
+{
+	double a = n[0], b = n[1], c = n[2];
+	q.a2 += weight * a * a; q.b2 += weight * b * b; q.c2 += weight * c * c;
+	q.ab += weight * a * b; q.ac += weight * a * c; q.bc += weight * b * c;
+	q.ad += weight * a * d; q.bd += weight * b * d; q.cd += weight * c * d;
+	q.d2 += weight * d * d;
+	q.weight += weight;
+}
+
+static void quadric_add(quadric_t &q, const quadric_t &other)
+{
+	q.a2 += other.a2; q.b2 += other.b2; q.c2 += other.c2;
+	q.ab += other.ab; q.ac += other.ac; q.bc += other.bc;
+	q.ad += other.ad; q.bd += other.bd; q.cd += other.cd;
+	q.d2 += other.d2;
+	q.weight += other.weight;
+}
+
+// mean squared distance of p to the planes of q
+static double quadric_error(const quadric_t &q, const vec3 &p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	double error = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z
+		+ 2 * (q.ab * x * y + q.ac * x * z + q.bc * y * z)
+		+ 2 * (q.ad * x + q.bd * y + q.cd * z) + q.d2;
+	return q.weight > 0 ? fabs(error) / q.weight : 0;
+}
+
+/* locked vertices */
+static void lock_vertices(const std::vector<unsigned int> &indices, const vec3 *positions, int num_verts,
+	std::vector<char> &locked)
+{
+	locked.assign(num_verts, 0);
+
+	// seams, welding keeps a vertex per distinct uv/normal, so a shared position marks a seam
+	std::unordered_map<unsigned long long, int> first_vertex;
+	first_vertex.reserve(num_verts);
+	for (int v = 0; v < num_verts; v++)
+	{
+		unsigned int bits[3];
+		memcpy(bits, &positions[v], sizeof(bits));
+		unsigned long long key = ((unsigned long long)bits[0] * 73856093ull) ^ ((unsigned long long)bits[1] << 21)
+			^ ((unsigned long long)bits[2] * 19349663ull << 7);
+		auto it = first_vertex.find(key);
+		if (it == first_vertex.end())
+			first_vertex.emplace(key, v);
+		else if (memcmp(&positions[it->second], &positions[v], sizeof(vec3)) == 0)
+			locked[it->second] = locked[v] = 1;
+		else
+			locked[v] = 1;	// hash collision, locking is always safe
+	}
+
+	// borders and non-manifold edges, used by one face or by more than two
+	std::vector<unsigned long long> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+			edges.push_back(a < b ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();)
+	{
+		size_t j = i;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		if (j - i != 2)
+		{
+			locked[edges[i] >> 32] = 1;
+			locked[edges[i] & 0xffffffffu] = 1;
+		}
+		i = j;
+	}
+}
+
+/* edge collapse */
+typedef struct
+{
+	unsigned int from;
+	unsigned int to;
+	float error;
+} collapse_t;
+
+// moving vertex from onto to must not turn any remaining face around
+static bool collapse_flips(const std::vector<unsigned int> &indices, const std::vector<int> &offsets,
+	const std::vector<int> &adjacency, const vec3 *positions, unsigned int from, unsigned int to)
+{
+	for (int j = offsets[from]; j < offsets[from + 1]; j++)
+	{
+		const unsigned int *face = &indices[adjacency[j] * 3];
+		if (face[0] == to || face[1] == to || face[2] == to)
+			continue;	// removed by the collapse
+
+		vec3 p[3], q[3];
+		for (int k = 0; k < 3; k++)
+		{
+			p[k] = positions[face[k]];
+			q[k] = face[k] == from ? positions[to] : p[k];
+		}
+		vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+		vec3 after = cross(q[1] - q[0], q[2] - q[0]);
+		if (dot(before, after) <= 0)
+			return true;
+	}
+	return false;
+}
+
+float simplify_mesh(std::vector<unsigned int> &indices, const vec3 *positions, int num_verts,
+	int target_faces, float target_error)
+{
+	std::vector<char> locked;
+	lock_vertices(indices, positions, num_verts, locked);
+
+	std::vector<quadric_t> quadrics(num_verts);
+	memset(quadrics.data(), 0, sizeof(quadric_t) * num_verts);
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const vec3 &a = positions[indices[i]];
+		const vec3 &b = positions[indices[i + 1]];
+		const vec3 &c = positions[indices[i + 2]];
+		vec3 n = cross(b - a, c - a);
+		float area = n.norm();
+		if (area < EPSILON * EPSILON)
+			continue;
+		n = n / area;
+		for (int k = 0; k < 3; k++)
+			quadric_add_plane(quadrics[indices[i + k]], n, -dot(n, a), area);
+	}
+
+	double max_error = (double)target_error * target_error;
+	double result_error = 0;
+	std::vector<int> offsets(num_verts + 1), adjacency;
+	std::vector<collapse_t> collapses;
+	std::vector<char> touched(num_verts);
+	std::vector<unsigned int> remap(num_verts);
+
+	// every pass collapses a set of independent edges in the order of their error
+	while ((int)indices.size() / 3 > target_faces)
+	{
+		int num_faces = (int)indices.size() / 3;
+
+		// faces around every vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < indices.size(); i++)
+			offsets[indices[i] + 1]++;
+		for (int v = 0; v < num_verts; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(indices.size());
+		std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[cursor[indices[i]]++] = (int)(i / 3);
+
+		// the cheaper direction of every edge, an edge is seen from both of its faces
+		collapses.clear();
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+				if (a > b || (locked[a] && locked[b]))
+					continue;
+				quadric_t q = quadrics[a];
+				quadric_add(q, quadrics[b]);
+				double error_ab = locked[a] ? 1e30 : quadric_error(q, positions[b]);
+				double error_ba = locked[b] ? 1e30 : quadric_error(q, positions[a]);
+				collapse_t collapse = { a, b, (float)error_ab };
+				if (error_ba < error_ab)
+				{
+					collapse.from = b;
+					collapse.to = a;
+					collapse.error = (float)error_ba;
+				}
+				if (collapse.error <= max_error)
+					collapses.push_back(collapse);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(),
+			[](const collapse_t &a, const collapse_t &b) { return a.error < b.error; });
+
+		// a collapse removes two faces of a closed surface
+		int faces_left = num_faces - target_faces;
+		int num_collapses = 0;
+		std::fill(touched.begin(), touched.end(), 0);
+		for (int v = 0; v < num_verts; v++)
+			remap[v] = v;
+		for (size_t c = 0; c < collapses.size() && faces_left > 0; c++)
+		{
+			const collapse_t &collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+			if (collapse_flips(indices, offsets, adjacency, positions, collapse.from, collapse.to))
+				continue;
+
+			// the faces around the removed vertex change, keep their vertices out of this pass
+			for (int j = offsets[collapse.from]; j < offsets[collapse.from + 1]; j++)
+			{
+				const unsigned int *face = &indices[adjacency[j] * 3];
+				touched[face[0]] = touched[face[1]] = touched[face[2]] = 1;
+			}
+			remap[collapse.from] = collapse.to;
+			quadric_add(quadrics[collapse.to], quadrics[collapse.from]);
+			result_error = std::max(result_error, (double)collapse.error);
+			faces_left -= 2;
+			num_collapses++;
+		}
+		if (num_collapses == 0)
+			break;
+
+		// move the collapsed vertices and drop the faces that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+	return (float)sqrt(result_error);
+}
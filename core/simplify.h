@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+
+#include "./maths.h"
+
+// levels of detail of a model, every level is a contiguous range of the index buffer
+// and of the meshlets, and all of them share the vertices of the full mesh
+#define MAX_MESH_LODS 4
+
+typedef struct
+{
+	int face_offset;
+	int face_count;
+	int meshlet_offset;
+	int meshlet_count;
+	float error;			// distance to the full mesh in model space, 0 for the full mesh
+} mesh_lod_t;
+
+// reduce the faces towards target_faces by edge collapses ordered by quadric error
+// (Garland and Heckbert 1997, "Surface Simplification Using Quadric Error Metrics").
+// vertices are only moved onto other vertices, so the vertex arrays stay untouched.
+// vertices on uv/normal seams (welded vertices sharing a position) and on borders are
+// locked, so the mesh never cracks open. collapses with an error larger than
+// target_error are rejected, return the largest error of the collapses done
+float simplify_mesh(std::vector<unsigned int> &indices, const vec3 *positions, int num_verts,
+	int target_faces, float target_error);
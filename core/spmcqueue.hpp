@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+
+// bounded lock-free queue with one producer and any number of consumers. the elements
+// live in the slots and are filled and read in place, a slot is only handed out again
+// after the consumer that popped it called end_pop. N must be a power of two
+// refer to: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename T, int N>
+class SPMCQueue {
+public:
+	SPMCQueue()
+	{
+		reset();
+	}
+
+	// only while no thread is using the queue
+	void reset()
+	{
+		for (unsigned int i = 0; i < (unsigned int)N; i++)
+			slots_[i].sequence.store(i, std::memory_order_relaxed);
+		head_.store(0, std::memory_order_relaxed);
+		tail_ = 0;
+	}
+
+	// producer: the next free slot, or NULL if the queue is full
+	T *begin_push()
+	{
+		slot_t &slot = slots_[tail_ % N];
+		if (slot.sequence.load(std::memory_order_acquire) != tail_)
+			return NULL;
+		return &slot.value;
+	}
+
+	// producer: publish the slot returned by begin_push
+	void end_push()
+	{
+		slots_[tail_ % N].sequence.store(tail_ + 1, std::memory_order_release);
+		tail_++;
+	}
+
+	// consumer: claim the oldest element, or NULL if the queue is empty
+	T *begin_pop(unsigned int &ticket)
+	{
+		unsigned int pos = head_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot_t &slot = slots_[pos % N];
+			int diff = (int)(slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+			if (diff == 0)
+			{
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					ticket = pos;
+					return &slot.value;
+				}
+			}
+			else if (diff < 0)
+				return NULL;
+			else
+				pos = head_.load(std::memory_order_relaxed);
+		}
+	}
+
+	// consumer: give the claimed slot back to the producer
+	void end_pop(unsigned int ticket)
+	{
+		slots_[ticket % N].sequence.store(ticket + N, std::memory_order_release);
+	}
+
+private:
+	struct slot_t
+	{
+		std::atomic<unsigned int> sequence;
+		T value;
+	};
+
+	static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+	slot_t slots_[N];
+	alignas(64) std::atomic<unsigned int> head_;
+	alignas(64) unsigned int tail_;
+};
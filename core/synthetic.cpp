@@ -0,0 +1,190 @@
+#include "./synthetic.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "./macro.h"
+
+static const char *SHAPE_NAMES[SYNTHETIC_SHAPE_NUM] = { "sphere", "grid", "overdraw", "micro" };
+
+const char *synthetic_shape_name(synthetic_shape shape)
+{
+	return SHAPE_NAMES[shape];
+}
+
+int find_synthetic_shape(const char *name)
+{
+	for (int i = 0; i < SYNTHETIC_SHAPE_NUM; i++)
+	{
+		if (strcmp(SHAPE_NAMES[i], name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/* geometry */
+typedef struct
+{
+	std::vector<vec3> positions;
+	std::vector<vec3> normals;
+	std::vector<vec2> texcoords;
+	std::vector<unsigned int> indices;
+} mesh_data_t;
+
+// grid of cols x rows quads on the plane through origin spanned by axis_u and axis_v, the faces
+// are counter-clockwise seen from the side cross(axis_u, axis_v) points to
+static void add_grid(mesh_data_t &mesh, vec3 origin, vec3 axis_u, vec3 axis_v, int cols, int rows)
+{
+	unsigned int first = (unsigned int)mesh.positions.size();
+	vec3 normal = unit_vector(cross(axis_u, axis_v));
+	for (int r = 0; r <= rows; r++)
+	{
+		for (int c = 0; c <= cols; c++)
+		{
+			float u = c / (float)cols, v = r / (float)rows;
+			mesh.positions.push_back(origin + axis_u * u + axis_v * v);
+			mesh.normals.push_back(normal);
+			mesh.texcoords.push_back(vec2(u, v));
+		}
+	}
+
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < cols; c++)
+		{
+			unsigned int i00 = first + r * (cols + 1) + c;
+			unsigned int i10 = i00 + 1, i01 = i00 + cols + 1, i11 = i01 + 1;
+			unsigned int quad[6] = { i00, i10, i01, i10, i11, i01 };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// cols x rows quads with the aspect of width x height and about num_triangles triangles
+static void grid_size(long long num_triangles, float width, float height, int &cols, int &rows)
+{
+	rows = (int)ceil(sqrt(num_triangles / 2.0 * height / width));
+	rows = rows > 1 ? rows : 1;
+	cols = (int)ceil(num_triangles / 2.0 / rows);
+	cols = cols > 1 ? cols : 1;
+}
+
+// the rings run from pole to pole, the quads at the poles are degenerate like in most exported meshes
+static void add_sphere(mesh_data_t &mesh, vec3 center, float radius, long long num_triangles)
+{
+	int rings = (int)ceil(sqrt(num_triangles / 4.0));
+	rings = rings > 2 ? rings : 2;
+	int segments = rings * 2;
+
+	unsigned int first = (unsigned int)mesh.positions.size();
+	for (int r = 0; r <= rings; r++)
+	{
+		for (int s = 0; s <= segments; s++)
+		{
+			float theta = (float)PI * r / rings, phi = 2 * (float)PI * s / segments;
+			vec3 normal(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			mesh.positions.push_back(center + normal * radius);
+			mesh.normals.push_back(normal);
+			mesh.texcoords.push_back(vec2(s / (float)segments, 1 - r / (float)rings));
+		}
+	}
+
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			unsigned int a = first + r * (segments + 1) + s, b = a + segments + 1;
+			unsigned int quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+/* textures */
+// gradients under a checker, with a little noise so neighbouring texels differ
+static TGAImage *create_diffuse_map(int size)
+{
+	TGAImage *image = new TGAImage(size, size, TGAImage::RGB);
+	unsigned int seed = 12345;
+	int cell = size / 8 > 1 ? size / 8 : 1;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			int noise = (seed >> 24) & 15;
+			int checker = ((x / cell) + (y / cell)) % 2 ? 96 : 0;
+			TGAColor c((unsigned char)(x * 159 / size + noise), (unsigned char)(y * 159 / size + noise),
+				(unsigned char)(64 + checker + noise));
+			image->set(x, y, c);
+		}
+	}
+	return image;
+}
+
+// tangent space bumps, so the normal mapping of the shaders does real work
+static TGAImage *create_normal_map(int size)
+{
+	TGAImage *image = new TGAImage(size, size, TGAImage::RGB);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			float nx = 0.3f * (float)sin(x * 2 * PI * 16 / size);
+			float ny = 0.3f * (float)sin(y * 2 * PI * 16 / size);
+			vec3 n = unit_vector(vec3(nx, ny, 1));
+			TGAColor c((unsigned char)((n.x() * 0.5f + 0.5f) * 255), (unsigned char)((n.y() * 0.5f + 0.5f) * 255),
+				(unsigned char)((n.z() * 0.5f + 0.5f) * 255));
+			image->set(x, y, c);
+		}
+	}
+	return image;
+}
+
+Model *create_synthetic_model(const synthetic_desc_t &desc)
+{
+	mesh_data_t mesh;
+	vec3 center(0, 1, 0);
+	long long num_triangles = desc.num_triangles > 1 ? desc.num_triangles : 1;
+	int cols, rows;
+
+	switch (desc.shape)
+	{
+		case SYNTHETIC_SPHERE:
+			add_sphere(mesh, center, 1.5f, num_triangles);
+			break;
+		case SYNTHETIC_GRID:
+			grid_size(num_triangles, 4, 3, cols, rows);
+			add_grid(mesh, center + vec3(-2, -1.5f, 0), vec3(4, 0, 0), vec3(0, 3, 0), cols, rows);
+			break;
+		case SYNTHETIC_OVERDRAW:
+		{
+			// back to front 0.1 apart, the same pixels are covered by every layer
+			int num_layers = desc.num_layers > 1 ? desc.num_layers : 1;
+			grid_size((num_triangles + num_layers - 1) / num_layers, 4, 3, cols, rows);
+			for (int i = 0; i < num_layers; i++)
+			{
+				float z = -0.1f * (num_layers - 1 - i);
+				add_grid(mesh, center + vec3(-2, -1.5f, z), vec3(4, 0, 0), vec3(0, 3, 0), cols, rows);
+			}
+			break;
+		}
+		case SYNTHETIC_MICRO:
+			// one unit square is about a hundred pixels wide at the default camera
+			grid_size(num_triangles, 1, 1, cols, rows);
+			add_grid(mesh, center + vec3(-0.5f, -0.5f, 0), vec3(1, 0, 0), vec3(0, 1, 0), cols, rows);
+			break;
+		default:
+			break;
+	}
+
+	printf("synthetic %s: faces %d vertices %d texture %d\n", synthetic_shape_name(desc.shape),
+		(int)mesh.indices.size() / 3, (int)mesh.positions.size(), desc.texture_size);
+	Model *model = new Model(std::move(mesh.positions), std::move(mesh.normals), std::move(mesh.texcoords),
+		std::move(mesh.indices), desc.mesh_flags);
+
+	int texture_size = desc.texture_size > 1 ? desc.texture_size : 1;
+	model->diffusemap = create_diffuse_map(texture_size);
+	model->normalmap = create_normal_map(texture_size);
+	return model;
+}
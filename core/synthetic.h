@@ -0,0 +1,29 @@
+#pragma once
+#include "./meshcache.h"
+#include "./model.h"
+
+// procedural models for scaling benchmarks, the geometry, fill and texture size are set
+// independently. every shape is centered at (0, 1, 0) and fits the view of the default camera
+typedef enum
+{
+	SYNTHETIC_SPHERE,		// tessellated sphere, the triangles shrink as their count grows
+	SYNTHETIC_GRID,			// one flat grid facing the camera
+	SYNTHETIC_OVERDRAW,		// stacked grids covering the same pixels, one layer of overdraw each
+	SYNTHETIC_MICRO,		// small dense patch, the triangles get smaller than a pixel
+	SYNTHETIC_SHAPE_NUM
+} synthetic_shape;
+
+typedef struct
+{
+	synthetic_shape shape;
+	long long num_triangles;	// approximate, the tessellation is rounded to whole rows
+	int texture_size;			// width and height of the diffuse and normal maps
+	int num_layers;				// grids of SYNTHETIC_OVERDRAW
+	unsigned int mesh_flags;	// MESH_FLAG_XXX processing, large meshes build faster without it
+} synthetic_desc_t;
+
+const char *synthetic_shape_name(synthetic_shape shape);
+// return -1 if there is no shape of that name
+int find_synthetic_shape(const char *name);
+
+Model *create_synthetic_model(const synthetic_desc_t &desc);
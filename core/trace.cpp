@@ -0,0 +1,148 @@
+#include "./trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if USE_TRACE
+static const int TRACE_RING_SIZE = 1 << 16;	// events per thread
+static const int MAX_TRACE_THREADS = 256;
+
+typedef struct
+{
+	const char *name;
+	long long begin;
+	long long end;
+} trace_event_t;
+
+// only the owning thread records into a ring, trace_write reads it once the thread is idle
+typedef struct
+{
+	char thread_name[32];
+	std::atomic<int> generation;		// trace the events belong to
+	std::atomic<unsigned int> head;		// events recorded in this trace, the ring keeps the last ones
+	trace_event_t events[TRACE_RING_SIZE];
+} trace_ring_t;
+
+std::atomic<int> trace_active(0);
+static std::atomic<int> trace_generation(0);
+static long long trace_origin = 0;
+
+// rings of every thread that ever recorded, they outlive their threads so the events of
+// workers that were shut down are still written
+static std::atomic<trace_ring_t *> rings[MAX_TRACE_THREADS];
+static std::atomic<int> num_rings(0);
+
+static thread_local trace_ring_t *thread_ring = NULL;
+static thread_local char thread_label[32] = "";
+
+// the ring is allocated on the first event, threads that are never traced don't pay for it
+static trace_ring_t *create_ring()
+{
+	int index = num_rings.fetch_add(1);
+	if (index >= MAX_TRACE_THREADS)
+		return NULL;
+
+	trace_ring_t *ring = new trace_ring_t();
+	if (thread_label[0] != '\0')
+		snprintf(ring->thread_name, sizeof(ring->thread_name), "%s", thread_label);
+	else
+		snprintf(ring->thread_name, sizeof(ring->thread_name), "thread %d", index);
+	ring->generation.store(-1, std::memory_order_relaxed);
+	ring->head.store(0, std::memory_order_relaxed);
+	rings[index].store(ring, std::memory_order_release);
+	return ring;
+}
+
+void trace_record(const char *name, long long begin, long long end)
+{
+	trace_ring_t *ring = thread_ring;
+	if (ring == NULL)
+	{
+		ring = thread_ring = create_ring();
+		if (ring == NULL)
+			return;
+	}
+
+	// the first event of a new trace drops the events of the earlier one
+	int generation = trace_generation.load(std::memory_order_relaxed);
+	unsigned int head = ring->head.load(std::memory_order_relaxed);
+	if (ring->generation.load(std::memory_order_relaxed) != generation)
+	{
+		ring->generation.store(generation, std::memory_order_relaxed);
+		head = 0;
+	}
+
+	trace_event_t &event = ring->events[head % TRACE_RING_SIZE];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void trace_start()
+{
+	trace_origin = trace_now();
+	trace_generation.fetch_add(1);
+	trace_active.store(1);
+}
+
+void trace_thread_name(const char *name)
+{
+	snprintf(thread_label, sizeof(thread_label), "%s", name);
+	if (thread_ring != NULL)
+		snprintf(thread_ring->thread_name, sizeof(thread_ring->thread_name), "%s", name);
+}
+
+// complete events in microseconds since trace_start, one track per thread
+int trace_write(const char *filename)
+{
+	trace_active.store(0);
+	FILE *file = fopen(filename, "w");
+	if (file == NULL)
+		return 0;
+
+	int generation = trace_generation.load();
+	int count = num_rings.load();
+	int first = 1;
+	fprintf(file, "{\"traceEvents\": [");
+	for (int i = 0; i < count && i < MAX_TRACE_THREADS; i++)
+	{
+		trace_ring_t *ring = rings[i].load(std::memory_order_acquire);
+		if (ring == NULL || ring->generation.load() != generation)
+			continue;
+
+		fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+			first ? "" : ",", i + 1, ring->thread_name);
+		first = 0;
+
+		unsigned int head = ring->head.load(std::memory_order_acquire);
+		unsigned int begin = head > (unsigned int)TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+		if (begin > 0)
+			printf("trace: the oldest %u events of %s were overwritten\n", begin, ring->thread_name);
+		for (unsigned int k = begin; k < head; k++)
+		{
+			const trace_event_t &event = ring->events[k % TRACE_RING_SIZE];
+			if (event.begin < trace_origin)
+				continue;
+			fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+				event.name, i + 1, (event.begin - trace_origin) / 1000.0, (event.end - event.begin) / 1000.0);
+		}
+	}
+	fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+	fclose(file);
+	return 1;
+}
+#else
+void trace_start()
+{
+}
+
+void trace_thread_name(const char *name)
+{
+}
+
+int trace_write(const char *filename)
+{
+	return 0;
+}
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+#include "./macro.h"
+
+// timeline of scoped markers for the chrome trace viewer or perfetto. every thread records into
+// its own ring buffer without locks, the oldest events are overwritten when a ring is full.
+// with USE_TRACE 0 the markers compile to nothing and trace_write writes no file
+
+#if USE_TRACE
+#include <atomic>
+#include <chrono>
+
+extern std::atomic<int> trace_active;
+
+static inline long long trace_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_record(const char *name, long long begin, long long end);
+
+// records the time from its construction to the end of the scope, name must outlive the trace
+class TraceScope
+{
+public:
+	TraceScope(const char *name) : name(name), begin(trace_active.load(std::memory_order_relaxed) ? trace_now() : 0) {}
+	~TraceScope()
+	{
+		if (begin != 0)
+			trace_record(name, begin, trace_now());
+	}
+private:
+	const char *name;
+	long long begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+// start recording, the events of an earlier trace are dropped
+void trace_start();
+// label of the calling thread in the timeline, it can be set before the trace is started
+void trace_thread_name(const char *name);
+// stop recording and write the events as chrome trace json, the traced threads should be idle.
+// return 0 if the file can't be written or tracing is compiled out
+int trace_write(const char *filename);
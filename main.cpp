@@ -1,14 +1,25 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
+#include <vector>
 
+#include "./core/jobsystem.h"
 #include "./core/macro.h"
 #include "./core/tgaimage.h"
 #include "./core/model.h"
+#include "./core/occlusion.h"
 #include "./core/camera.h"
+#include "./core/frame.h"
 #include "./core/pipeline.h"
+#include "./core/presenter.h"
 #include "./core/sample.h"
 #include "./core/scene.h"
-#include "./platform/win32.h"
+#include "./core/trace.h"
+#include "./platform/headless.h"
+#include "./platform/platform.h"
 #include "./shader/shader.h"
 
 using namespace std;
@@ -16,93 +27,216 @@ using namespace std;
 const vec3 Eye(0, 1, 5);
 const vec3 Up(0, 1, 0);
 const vec3 Target(0, 1, 0);
+// framebuffers in the presentation ring: one presented, one drawn and one prepared
+const int PRESENT_BUFFERS = 3;
 
-const scene_t Scenes[]
+// command line options, without any the window shows a random scene until it is closed.
+// batch mode renders a fixed number of frames headless as fast as possible
+typedef struct
 {
-	{"fuhua",build_fuhua_scene},
-	{"qiyana",build_qiyana_scene},
-	{"yayi",build_yayi_scene},
-	{"xier",build_xier_scene},
-	{"helmet",build_helmet_scene},
-	{"gun",build_gun_scene},
-};
-
-void clear_zbuffer(int width, int height, float* zbuffer);
-void clear_framebuffer(int width, int height, unsigned char* framebuffer);
-void update_matrix(Camera &camera, mat4 view_mat, mat4 perspective_mat, IShader *shader_model, IShader *shader_skybox);
-
-int main()
+	const char *scene_name;			// NULL for a random scene
+	int width;
+	int height;
+	int batch;
+	int num_frames;					// batch mode, 0 for one frame per pose of the path
+	int parallel_frames;			// batch mode, frames drawn at the same time, 0 to draw one frame with all threads
+	draw_mode mode;					// how the models of a frame are drawn
+	vec3 eye;
+	vec3 target;
+	const char *path_filename;		// batch mode, camera pose of every frame
+	const char *output_pattern;		// batch mode, printf pattern of the written frames
+	const char *trace_filename;		// chrome trace of the whole run, NULL to not trace
+} options_t;
+
+// without a display the camera orbits the target once by a scripted drag of the left button,
+// then the window closes
+const int HEADLESS_FRAMES = 120;
+
+void orbit_script(window_t *window, int dispatch_index, vec2 &mouse_pos)
+{
+	if (dispatch_index == 0)
+	{
+		window->buttons[0] = 1;
+		window->mouse_info.orbit_pos = mouse_pos;
+	}
+	// a drag of 4/3 of the window width is a full turn, see updata_camera_pos
+	mouse_pos[0] -= window->width * 4.0f / 3.0f / HEADLESS_FRAMES;
+	if (dispatch_index + 1 >= HEADLESS_FRAMES)
+		window->is_close = 1;
+}
+
+// pipeline counters of the frames drawn since they were last printed
+typedef struct
+{
+	int num_frames;
+	long long num_covered;
+	draw_counters_t counters;
+} frame_stats_t;
+
+int parse_options(int argc, char **argv, options_t &options);
+void print_usage();
+void write_frame(unsigned char *framebuffer);
+void add_frame_stats(frame_stats_t &stats, const frame_t &frame);
+void print_frame_stats(const frame_stats_t &stats);
+int render_frames_parallel(frame_t *frames, int num_slots, const options_t &options, const std::vector<camera_pose_t> &poses,
+	Camera &camera, mat4 perspective_mat, Model **model, int model_num, frame_stats_t &stats);
+
+// frames written by write_frame, it runs on the presenter thread in submission order
+static const char *output_pattern = NULL;
+static int output_index = 0;
+
+int main(int argc, char **argv)
 {
 	// initialization
 	// --------------
-	// malloc memory for zbuffer and framebuffer
-	int width = WINDOW_WIDTH, height = WINDOW_HEIGHT;
-	float *zbuffer				= (float *)malloc(sizeof(float) * width * height);
-	unsigned char* framebuffer  = (unsigned char *)malloc(sizeof(unsigned char) * width * height * 4);
-	memset(framebuffer, 0, sizeof(unsigned char) * width * height * 4);
+	options_t options;
+	if (!parse_options(argc, argv, options))
+	{
+		print_usage();
+		return 1;
+	}
+
+	// camera of every frame in batch mode
+	std::vector<camera_pose_t> poses;
+	if (options.path_filename != NULL && !load_camera_path(options.path_filename, poses))
+	{
+		printf("can't load the camera path %s\n", options.path_filename);
+		return 1;
+	}
+	if (poses.empty())
+	{
+		camera_pose_t pose = { options.eye, options.target };
+		poses.push_back(pose);
+	}
+	if (options.batch && options.num_frames == 0)
+		options.num_frames = (int)poses.size();
+
+	// the trace starts before the workers, so it covers the loading of the scene
+	trace_thread_name("main");
+	if (options.trace_filename != NULL)
+	{
+#if USE_TRACE
+		trace_start();
+#else
+		printf("tracing is compiled out, set USE_TRACE in macro.h\n");
+#endif
+	}
+
+	// start the worker threads shared by loading and rendering
+	job_system_init(-1);
 
 	// create camera
-	Camera camera(Eye, Target, Up, (float)(width) / height);
+	int width = options.width, height = options.height;
+	Camera camera(options.eye, options.target, Up, (float)(width) / height);
 
-	// set mvp matrix
-	mat4 model_mat			= mat4::identity();
-	mat4 view_mat			= mat4_lookat(camera.eye, camera.target, camera.up);
+	// set perspective matrix
 	mat4 perspective_mat	= mat4_perspective(60, (float)(width)/height, -0.1, -10000);
 
 	// initialize models and shaders by builidng a scene
 	srand((unsigned int)time(NULL));
-	int scene_index = rand() % 6;
+	const scene_t *scene = options.scene_name ? find_scene(options.scene_name) : scene_at(rand() % scene_count());
+	if (scene == NULL)
+	{
+		printf("unknown scene %s\n", options.scene_name);
+		job_system_shutdown();
+		return 1;
+	}
 	int model_num = 0;
 	Model	*model[MAX_MODEL_NUM];
 	IShader *shader_model;
 	IShader *shader_skybox;
-	Scenes[scene_index].build_scene(model, model_num, &shader_model, &shader_skybox, perspective_mat, &camera);
+	{
+		TRACE_SCOPE("build_scene");
+		scene->build_scene(model, model_num, &shader_model, &shader_skybox, perspective_mat, &camera);
+	}
+
+	// malloc memory for the buffers of the frames in flight, the frame-parallel mode draws
+	// every frame on one thread since its frames already keep all threads busy
+	int num_slots = options.parallel_frames > 0 ? options.parallel_frames : 2;
+	draw_mode mode = options.parallel_frames > 0 ? DRAW_SERIAL : options.mode;
+	std::vector<frame_t> frames(num_slots);
+	for (int i = 0; i < num_slots; i++)
+		create_frame(frames[i], width, height, camera, shader_model, shader_skybox, mode);
 
-	// initialize window
-	window_init(width, height, "SRender");
+	// initialize window, the frames are displayed or written by the presenter thread
+	if (options.batch)
+	{
+		output_pattern = options.output_pattern;
+		window_init_backend(&headless_backend, width, height, "SRender");
+		presenter_init(width, height, std::max(num_slots + 1, PRESENT_BUFFERS), write_frame);
+	}
+	else
+	{
+		if (default_window_backend() == &headless_backend)
+			headless_set_input_script(orbit_script);
+		window_init(width, height, "SRender");
+		presenter_init(width, height, PRESENT_BUFFERS, window_draw);
+	}
 
 	// render loop
 	// -----------
-	int num_frames = 0;
-	float print_time = platform_get_time();
-	while (!window->is_close)
+	// frame n is drawn by a job while the main thread handles the events and prepares frame n + 1,
+	// the job hands the finished framebuffer to the presenter
+	int num_frames = 0, frame_index = 0;
+	float start_time = platform_get_time();
+	float print_time = start_time;
+	int current = 0, is_drawing = 0;
+	job_group_t draw_group;
+	frame_stats_t interval_stats = {}, total_stats = {};
+	if (options.parallel_frames > 0)
+		frame_index = render_frames_parallel(frames.data(), num_slots, options, poses, camera, perspective_mat, model,
+			model_num, total_stats);
+	while (options.parallel_frames == 0 && (options.batch ? frame_index < options.num_frames : !window->is_close))
 	{
 		float curr_time = platform_get_time();
+		frame_t &frame = frames[current];
 
-		// clear buffer
-		clear_framebuffer(width, height, framebuffer);
-		clear_zbuffer(width, height, zbuffer);
-
-		// handle events and update view, perspective matrix
-		handle_events(camera);
-		update_matrix(camera, view_mat, perspective_mat, shader_model, shader_skybox);
-
-		// draw models
-		for (int m = 0; m < model_num; m++)
-		{
-			// assign model data to shader
-			shader_model->payload.model = model[m];
-			if(shader_skybox != NULL) shader_skybox->payload.model = model[m];
-			
-			// select current shader according model type
-			IShader *shader;
-			if (model[m]->is_skybox)
-				shader = shader_skybox;
-			else
-				shader = shader_model;
-
-			for (int i = 0; i < model[m]->nfaces(); i++)
-			{
-				draw_triangles(framebuffer, zbuffer, *shader, i);
-			}
+		// handle events or take the pose of the path, clear the buffers and cull the models of this frame
+		if (options.batch)
+		{
+			const camera_pose_t &pose = poses[frame_index % poses.size()];
+			camera.eye = pose.eye;
+			camera.target = pose.target;
+		}
+		else
+		{
+			TRACE_SCOPE("handle_events");
+			handle_events(camera);
+		}
+		{
+			TRACE_SCOPE("presenter_acquire");
+			frame.framebuffer = presenter_acquire();
+		}
+		prepare_frame(frame, camera, perspective_mat, model, model_num);
+
+		// wait for the previous frame, so the frames are presented in order and its slot is free
+		// to be prepared in the next iteration
+		if (is_drawing)
+		{
+			TRACE_SCOPE("wait_frame");
+			job_wait(draw_group);
+			add_frame_stats(interval_stats, frames[1 - current]);
+			add_frame_stats(total_stats, frames[1 - current]);
 		}
 
+		// draw this frame in the background
+		job_submit(draw_group, [&frame, &model, model_num]()
+		{
+			draw_frame(frame, model, model_num);
+			presenter_submit(frame.framebuffer);
+		});
+		is_drawing = 1;
+		current = 1 - current;
+		frame_index++;
+
 		// calculate and display FPS
 		num_frames += 1;
         if (curr_time - print_time >= 1) {
             int sum_millis = (int)((curr_time - print_time) * 1000);
             int avg_millis = sum_millis / num_frames;
-            printf("fps: %3d, avg: %3d ms\n", num_frames, avg_millis);
+            printf("fps: %3d, avg: %3d ms, ", num_frames, avg_millis);
+            print_frame_stats(interval_stats);
+            interval_stats = frame_stats_t();
             num_frames = 0;
             print_time = curr_time;
         }
@@ -111,11 +245,21 @@ int main()
 		window->mouse_info.wheel_delta = 0;
 		window->mouse_info.orbit_delta = vec2(0,0);
 		window->mouse_info.fv_delta = vec2(0, 0);
-
-		// send framebuffer to window 
-		window_draw(framebuffer);
+		TRACE_SCOPE("msg_dispatch");
 		msg_dispatch();
 	}
+	job_wait(draw_group);
+	if (is_drawing)
+		add_frame_stats(total_stats, frames[1 - current]);
+	presenter_shutdown();
+
+	if (options.batch)
+	{
+		float total_time = platform_get_time() - start_time;
+		printf("frames: %d, total: %.1f ms, avg: %.2f ms, fps: %.1f\n", frame_index, total_time * 1000,
+			total_time * 1000 / frame_index, frame_index / total_time);
+		print_frame_stats(total_stats);
+	}
 
 
 	// free memory
@@ -123,50 +267,256 @@ int main()
 		if (model[i] != NULL)  delete model[i];
 	if (shader_model != NULL)  delete shader_model;
 	if (shader_skybox != NULL) delete shader_skybox;
-	free(zbuffer);
-	free(framebuffer);
+	for (int i = 0; i < num_slots; i++)
+		destroy_frame(frames[i]);
 	window_destroy();
+	job_system_shutdown();
+
+	// every traced thread has stopped
+	if (options.trace_filename != NULL && trace_write(options.trace_filename))
+		printf("trace written to %s\n", options.trace_filename);
 
-	system("pause");
+#ifdef _WIN32
+	if (!options.batch)
+		system("pause");
+#endif
 	return 0;
 }
 
-
-void clear_zbuffer(int width, int height, float* zbuffer)
+void print_usage()
 {
-	for (int i = 0; i < width*height; i++)
-		zbuffer[i] = 100000;
+	printf(
+		"usage: SRender [options]\n"
+		"  --scene NAME       fuhua, qiyana, yayi, xier, helmet or gun, random by default\n"
+		"  --size WxH         resolution, 800x600 by default\n"
+		"  --eye X,Y,Z        camera position, 0,1,5 by default\n"
+		"  --target X,Y,Z     point the camera looks at, 0,1,0 by default\n"
+		"  --draw-mode MODE   serial, immediate, pipelined or auto, auto by default draws models with\n"
+		"                     few faces in immediate mode and the others pipelined. --parallel-frames\n"
+		"                     always draws serial and only accepts serial\n"
+		"  --trace FILE       write a timeline of the loading and of every frame as chrome trace json,\n"
+		"                     open it in chrome://tracing or ui.perfetto.dev\n"
+		"batch mode, render headless and exit:\n"
+		"  --frames N         number of frames, one per pose of the path by default\n"
+		"  --path FILE        camera path, one \"eye_x eye_y eye_z target_x target_y target_z\" per line,\n"
+		"                     frame i takes the pose of line i and the path repeats\n"
+		"  --output PATTERN   write frame i to PATTERN formatted with i, e.g. frames/%%04d.tga\n"
+		"  --parallel-frames N  draw N frames at the same time with one thread each instead of\n"
+		"                     one frame with all threads, for the throughput of long sequences\n");
 }
 
-void clear_framebuffer(int width, int height, unsigned char* framebuffer)
+// the pattern is the format string of snprintf with the frame index as the only argument, so
+// it must have exactly one %d or %i conversion (with optional flags, width and precision),
+// other % signs have to be written as %%
+static int is_frame_pattern(const char *pattern)
 {
-	for (int i = 0; i < height; i++)
+	int num_conversions = 0;
+	for (const char *p = pattern; *p != '\0'; p++)
 	{
-		for (int j = 0; j < width; j++)
+		if (*p != '%')
+			continue;
+		p++;
+		if (*p == '%')
+			continue;
+		while (*p != '\0' && strchr("-+ #0", *p) != NULL)
+			p++;
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (*p == '.')
 		{
-			int index = (i * width + j) * 4;
+			p++;
+			while (*p >= '0' && *p <= '9')
+				p++;
+		}
+		if (*p != 'd' && *p != 'i')
+			return 0;
+		num_conversions++;
+	}
+	return num_conversions == 1;
+}
 
-			framebuffer[index + 2] = 80;
-			framebuffer[index + 1] = 56;
-			framebuffer[index] = 56;
+static int parse_vec3(const char *text, vec3 &v)
+{
+	float x, y, z;
+	if (sscanf(text, "%f,%f,%f", &x, &y, &z) != 3)
+		return 0;
+	v = vec3(x, y, z);
+	return 1;
+}
+
+int parse_options(int argc, char **argv, options_t &options)
+{
+	options.scene_name = NULL;
+	options.width = WINDOW_WIDTH;
+	options.height = WINDOW_HEIGHT;
+	options.batch = 0;
+	options.num_frames = 0;
+	options.parallel_frames = 0;
+	options.mode = DRAW_AUTO;
+	options.eye = Eye;
+	options.target = Target;
+	options.path_filename = NULL;
+	options.output_pattern = NULL;
+	options.trace_filename = NULL;
+
+	int has_mode = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (strcmp(arg, "--help") == 0 || value == NULL)
+			return 0;
+
+		if (strcmp(arg, "--scene") == 0)
+			options.scene_name = value;
+		else if (strcmp(arg, "--size") == 0)
+		{
+			if (sscanf(value, "%dx%d", &options.width, &options.height) != 2 || options.width < 2 || options.height < 2)
+				return 0;
+		}
+		else if (strcmp(arg, "--eye") == 0)
+		{
+			if (!parse_vec3(value, options.eye))
+				return 0;
+		}
+		else if (strcmp(arg, "--target") == 0)
+		{
+			if (!parse_vec3(value, options.target))
+				return 0;
+		}
+		else if (strcmp(arg, "--frames") == 0)
+		{
+			options.num_frames = atoi(value);
+			options.batch = 1;
+			if (options.num_frames <= 0)
+				return 0;
+		}
+		else if (strcmp(arg, "--path") == 0)
+		{
+			options.path_filename = value;
+			options.batch = 1;
+		}
+		else if (strcmp(arg, "--parallel-frames") == 0)
+		{
+			options.parallel_frames = atoi(value);
+			options.batch = 1;
+			if (options.parallel_frames <= 0)
+				return 0;
+		}
+		else if (strcmp(arg, "--output") == 0)
+		{
+			if (!is_frame_pattern(value))
+			{
+				printf("the output pattern needs exactly one integer conversion for the frame index, e.g. %%04d\n");
+				return 0;
+			}
+			options.output_pattern = value;
+			options.batch = 1;
 		}
+		else if (strcmp(arg, "--draw-mode") == 0)
+		{
+			int mode = find_draw_mode(value);
+			if (mode < 0)
+				return 0;
+			options.mode = (draw_mode)mode;
+			has_mode = 1;
+		}
+		else if (strcmp(arg, "--trace") == 0)
+			options.trace_filename = value;
+		else
+			return 0;
+		i++;
+	}
+
+	// the threaded modes spin on the jobs of their draw, with several frames in flight those
+	// jobs can sit behind the spinning workers of the other frames
+	if (options.parallel_frames > 0 && has_mode && options.mode != DRAW_SERIAL)
+	{
+		printf("--parallel-frames draws every frame serial, it can't be combined with --draw-mode %s\n",
+			draw_mode_name(options.mode));
+		return 0;
+	}
+	return 1;
+}
+
+// present callback of batch mode, the framebuffer is stored top-left first like a tga file
+void write_frame(unsigned char *framebuffer)
+{
+	int index = output_index++;
+	if (output_pattern == NULL)
+		return;
+
+	int width = window->width, height = window->height;
+	TGAImage image(width, height, TGAImage::RGB);
+	unsigned char *data = image.buffer();
+	for (int i = 0; i < width * height; i++)
+	{
+		data[i * 3]		= framebuffer[i * 4 + 2];
+		data[i * 3 + 1] = framebuffer[i * 4 + 1];
+		data[i * 3 + 2] = framebuffer[i * 4];
 	}
+
+	// uncompressed, rle encoding would cost more than the rendering of a small frame
+	char filename[1024];
+	snprintf(filename, sizeof(filename), output_pattern, index);
+	image.write_tga_file(filename, false);
 }
 
-void update_matrix(Camera &camera, mat4 view_mat, mat4 perspective_mat, IShader *shader_model, IShader *shader_skybox)
+void add_frame_stats(frame_stats_t &stats, const frame_t &frame)
 {
-	view_mat = mat4_lookat(camera.eye, camera.target, camera.up);
-	mat4 mvp = perspective_mat * view_mat;
-	shader_model->payload.camera_view_matrix = view_mat;
-	shader_model->payload.mvp_matrix = mvp;
+	stats.num_frames++;
+	stats.num_covered += frame.num_covered;
+	add_draw_counters(stats.counters, frame.counters);
+}
+
+// averages per frame. the overdraw is the fragments per covered pixel, the shading rate the
+// fragment shader invocations per covered pixel, the difference is rejected by the zbuffer
+void print_frame_stats(const frame_stats_t &stats)
+{
+	if (stats.num_frames == 0)
+	{
+		printf("no frame drawn\n");
+		return;
+	}
+	const draw_counters_t &c = stats.counters;
+	long long n = stats.num_frames;
+	double covered = stats.num_covered > 0 ? (double)stats.num_covered : 1;
+	printf("per frame: faces %lld, clip culled %lld, backface culled %lld, rasterized %lld, fragments %lld, "
+		"depth failed %lld, shaded %lld, overdraw %.2f, shading rate %.2f\n", c.faces / n, c.clip_culled / n,
+		c.backface_culled / n, c.rasterized / n, c.fragments / n, c.depth_failed / n, c.shaded / n,
+		c.fragments / covered, c.shaded / covered);
+}
 
-	if (shader_skybox != NULL)
+// frame-parallel batch rendering: every frame is prepared and drawn by one job with the buffers,
+// shaders and draw context of its slot. the jobs finish in any order, the main thread submits
+// the frames to the presenter in order and reuses a slot once its frame is submitted
+int render_frames_parallel(frame_t *frames, int num_slots, const options_t &options, const std::vector<camera_pose_t> &poses,
+	Camera &camera, mat4 perspective_mat, Model **model, int model_num, frame_stats_t &stats)
+{
+	std::vector<job_group_t> groups(num_slots);
+	for (int i = 0; i < options.num_frames + num_slots; i++)
 	{
-		mat4 view_skybox = view_mat;
-		view_skybox[0][3] = 0;
-		view_skybox[1][3] = 0;
-		view_skybox[2][3] = 0;
-		shader_skybox->payload.camera_view_matrix = view_skybox;
-		shader_skybox->payload.mvp_matrix = perspective_mat * view_skybox;
+		int slot = i % num_slots;
+		frame_t &frame = frames[slot];
+		if (i >= num_slots && i - num_slots < options.num_frames)
+		{
+			TRACE_SCOPE("wait_frame");
+			job_wait(groups[slot]);
+			add_frame_stats(stats, frame);
+			presenter_submit(frame.framebuffer);
+		}
+		if (i >= options.num_frames)
+			continue;
+
+		const camera_pose_t &pose = poses[i % poses.size()];
+		camera.eye = pose.eye;
+		camera.target = pose.target;
+		frame.framebuffer = presenter_acquire();
+		job_submit(groups[slot], [&frame, camera, perspective_mat, model, model_num]() mutable
+		{
+			prepare_frame(frame, camera, perspective_mat, model, model_num);
+			draw_frame(frame, model, model_num);
+		});
 	}
-}
\ No newline at end of file
+	return options.num_frames;
+}
@@ -0,0 +1,67 @@
+#include "./headless.h"
+
+#include <cstdlib>
+#include <cstring>
+
+typedef struct
+{
+	vec2 mouse_pos;
+	int num_dispatches;
+} headless_data_t;
+
+static input_script_t input_script = NULL;
+
+void headless_set_input_script(input_script_t script)
+{
+	input_script = script;
+}
+
+static int headless_init(window_t *window, const char *title)
+{
+	headless_data_t *data = new headless_data_t();
+	data->mouse_pos = vec2(0, 0);
+	data->num_dispatches = 0;
+	window->native = data;
+
+	// offscreen copy of the last frame
+	window->window_fb = (unsigned char *)malloc(window->width * window->height * 4);
+	memset(window->window_fb, 0, window->width * window->height * 4);
+	memset(window->keys, 0, sizeof(char) * 512);
+	return 0;
+}
+
+static void headless_destroy(window_t *window)
+{
+	free(window->window_fb);
+	window->window_fb = NULL;
+	delete (headless_data_t *)window->native;
+	window->native = NULL;
+}
+
+static void headless_draw(window_t *window, unsigned char *framebuffer)
+{
+	memcpy(window->window_fb, framebuffer, window->width * window->height * 4);
+}
+
+static void headless_dispatch(window_t *window)
+{
+	headless_data_t *data = (headless_data_t *)window->native;
+	if (input_script)
+		input_script(window, data->num_dispatches, data->mouse_pos);
+	data->num_dispatches++;
+}
+
+static vec2 headless_mouse_pos(window_t *window)
+{
+	return ((headless_data_t *)window->native)->mouse_pos;
+}
+
+const window_backend_t headless_backend =
+{
+	"headless",
+	headless_init,
+	headless_destroy,
+	headless_draw,
+	headless_dispatch,
+	headless_mouse_pos,
+};
@@ -0,0 +1,10 @@
+#pragma once
+#include "./platform.h"
+
+// the headless backend keeps the last frame in window->window_fb, in the layout of the
+// framebuffer, and takes its input from a script instead of a user
+
+// called by every msg_dispatch with the number of dispatches before it. the script may set
+// window->keys, buttons, mouse_info and is_close, and mouse_pos, returned by get_mouse_pos
+typedef void (*input_script_t)(window_t *window, int dispatch_index, vec2 &mouse_pos);
+void headless_set_input_script(input_script_t script);
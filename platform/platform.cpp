@@ -0,0 +1,89 @@
+#include "./platform.h"
+#include "../core/trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+window_t* window = NULL;
+static const window_backend_t *backend = NULL;
+
+const window_backend_t *default_window_backend()
+{
+#ifdef _WIN32
+	return &win32_backend;
+#else
+	return &headless_backend;
+#endif
+}
+
+int window_init(int width, int height, const char *title)
+{
+	return window_init_backend(default_window_backend(), width, height, title);
+}
+
+int window_init_backend(const window_backend_t *window_backend, int width, int height, const char *title)
+{
+	window = (window_t*)malloc(sizeof(window_t));
+	memset(window, 0, sizeof(window_t));
+	window->width = width;
+	window->height = height;
+	window->is_close = 0;
+
+	backend = window_backend;
+	return backend->init(window, title);
+}
+
+int window_destroy()
+{
+	backend->destroy(window);
+	free(window);
+	window = NULL;
+	backend = NULL;
+	return 0;
+}
+
+void window_draw(unsigned char *framebuffer)
+{
+	TRACE_SCOPE("window_draw");
+	backend->draw(window, framebuffer);
+}
+
+void msg_dispatch()
+{
+	backend->dispatch(window);
+}
+
+vec2 get_mouse_pos()
+{
+	return backend->mouse_pos(window);
+}
+
+/* misc platform functions */
+float platform_get_time(void)
+{
+	typedef std::chrono::steady_clock clock;
+	static const clock::time_point initial = clock::now();
+	return std::chrono::duration<float>(clock::now() - initial).count();
+}
+
+int platform_pin_thread(int cpu)
+{
+#ifdef _WIN32
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return 0;
+#endif
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "../core/maths.h"
+
+// keys that have no character, the values match the win32 virtual-key codes
+enum
+{
+	KEY_ESCAPE	= 0x1B,
+	KEY_LEFT	= 0x25,
+	KEY_UP		= 0x26,
+	KEY_RIGHT	= 0x27,
+	KEY_DOWN	= 0x28
+};
+
+typedef struct mouse
+{
+	// for camera orbit
+	vec2 orbit_pos;
+	vec2 orbit_delta;
+	// for first-person view (diabled now)
+	vec2 fv_pos;
+	vec2 fv_delta;
+	// for mouse wheel
+	float wheel_delta;
+}mouse_t;
+
+typedef struct window
+{
+	unsigned char *window_fb;	// pixels of the last window_draw, in the layout of the backend
+	int width;
+	int height;
+	char keys[512];				// indexed by upper case character or KEY_XXX
+	char buttons[2];			// left button: 0, right button: 1
+	int is_close;
+	mouse_t mouse_info;
+	void *native;				// data of the backend
+}window_t;
+
+extern window_t* window;
+
+// a window backend, the window_xxx functions forward to the one the window was created with
+typedef struct
+{
+	const char *name;
+	int  (*init)(window_t *window, const char *title);
+	void (*destroy)(window_t *window);
+	void (*draw)(window_t *window, unsigned char *framebuffer);
+	void (*dispatch)(window_t *window);
+	vec2 (*mouse_pos)(window_t *window);
+} window_backend_t;
+
+#ifdef _WIN32
+extern const window_backend_t win32_backend;
+#endif
+// offscreen window for machines without a display, see headless.h
+extern const window_backend_t headless_backend;
+
+// win32 on windows, headless everywhere else
+const window_backend_t *default_window_backend();
+
+int window_init(int width, int height, const char *title);
+int window_init_backend(const window_backend_t *backend, int width, int height, const char *title);
+int window_destroy();
+void window_draw(unsigned char *framebuffer);
+void msg_dispatch();
+vec2 get_mouse_pos();
+
+// seconds since the first call, from a monotonic high resolution clock
+float platform_get_time(void);
+// bind the calling thread to one cpu, return 0 if that is not supported
+int platform_pin_thread(int cpu);
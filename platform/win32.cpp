@@ -1,9 +1,22 @@
-#include "./win32.h"
+#include "./platform.h"
 
+#include <Windows.h>
 #include <cassert>
 #include <cstdio>
 
-window_t* window = NULL;
+static_assert(KEY_ESCAPE == VK_ESCAPE && KEY_LEFT == VK_LEFT && KEY_UP == VK_UP &&
+	KEY_RIGHT == VK_RIGHT && KEY_DOWN == VK_DOWN, "KEY_XXX must match the virtual-key codes");
+
+typedef struct
+{
+	HWND h_window;
+	HDC mem_dc;
+	HBITMAP bm_old;
+	HBITMAP bm_dib;
+} win32_data_t;
+
+static void win32_dispatch(window_t *window);
+static vec2 win32_mouse_pos(window_t *window);
 
 static LRESULT CALLBACK msg_callback(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) 
 {
@@ -19,13 +32,13 @@ static LRESULT CALLBACK msg_callback(HWND hWnd, UINT msg, WPARAM wParam, LPARAM
 			window->keys[wParam & 511] = 0; 
 			break;
 		case WM_LBUTTONDOWN:
-			window->mouse_info.orbit_pos = get_mouse_pos();
+			window->mouse_info.orbit_pos = win32_mouse_pos(window);
 			window->buttons[0] = 1; break;
 		case WM_LBUTTONUP:
 			window->buttons[0] = 0; 
 			break;
 		case WM_RBUTTONDOWN:
-			window->mouse_info.fv_pos = get_mouse_pos();
+			window->mouse_info.fv_pos = win32_mouse_pos(window);
 			window->buttons[1] = 1; 
 			break;
 		case WM_RBUTTONUP:
@@ -98,11 +111,13 @@ static void init_bm_header(BITMAPINFOHEADER &bi,int width,int height)
 	bi.biSizeImage = width * height * 4;
 }
 
-int window_init(int width, int height, const char *title) 
+static int win32_init(window_t *window, const char *title)
 {
-	window = (window_t*)malloc(sizeof(window_t));
-	memset(window, 0, sizeof(window_t));
-	window->is_close = 0;
+	int width = window->width;
+	int height = window->height;
+	win32_data_t *data = (win32_data_t *)malloc(sizeof(win32_data_t));
+	memset(data, 0, sizeof(win32_data_t));
+	window->native = data;
 
 	RECT rect = { 0, 0, width, height }; //һηΧ 
 	int wx, wy, sx, sy;
@@ -114,43 +129,40 @@ int window_init(int width, int height, const char *title)
 	register_window_class();
 	
 	//
-	window->h_window = CreateWindow(("SRender_window"), title,
+	data->h_window = CreateWindow(("SRender_window"), title,
 							WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX,
 							0, 0, 0, 0, NULL, NULL, GetModuleHandle(NULL), NULL);
-	assert(window->h_window != NULL);
+	assert(data->h_window != NULL);
 
 	//ʼλͼͷʽ
 	init_bm_header(bi, width, height);
 
 	//üDC
-	hDC = GetDC(window->h_window);  
-	window->mem_dc = CreateCompatibleDC(hDC);
-	ReleaseDC(window->h_window, hDC);
+	hDC = GetDC(data->h_window);  
+	data->mem_dc = CreateCompatibleDC(hDC);
+	ReleaseDC(data->h_window, hDC);
 
 	//λͼ
-	window->bm_dib = CreateDIBSection(window->mem_dc, (BITMAPINFO*)&bi, DIB_RGB_COLORS, &ptr, 0, 0); //豸޹ؾ
-	assert(window->bm_dib !=NULL);
+	data->bm_dib = CreateDIBSection(data->mem_dc, (BITMAPINFO*)&bi, DIB_RGB_COLORS, &ptr, 0, 0); //豸޹ؾ
+	assert(data->bm_dib !=NULL);
 
-	window->bm_old = (HBITMAP)SelectObject(window->mem_dc, window->bm_dib);//´λͼдmem_dc
+	data->bm_old = (HBITMAP)SelectObject(data->mem_dc, data->bm_dib);//´λͼдmem_dc
 	window->window_fb = (unsigned char*)ptr;
 
-	window->width = width;
-	window->height = height;
 
-
-	AdjustWindowRect(&rect, GetWindowLong(window->h_window, GWL_STYLE), 0);//ڴС
+	AdjustWindowRect(&rect, GetWindowLong(data->h_window, GWL_STYLE), 0);//ڴС
 	wx = rect.right - rect.left;
 	wy = rect.bottom - rect.top;
 	sx = (GetSystemMetrics(SM_CXSCREEN) - wx) / 2; // GetSystemMetrics(SM_CXSCREEN)ȡĻķƬ
 	sy = (GetSystemMetrics(SM_CYSCREEN) - wy) / 2; // λ
 	if (sy < 0) sy = 0;
 
-	SetWindowPos(window->h_window, NULL, sx, sy, wx, wy, (SWP_NOCOPYBITS | SWP_NOZORDER | SWP_SHOWWINDOW));
-	SetForegroundWindow(window->h_window);
-	ShowWindow(window->h_window, SW_NORMAL);
+	SetWindowPos(data->h_window, NULL, sx, sy, wx, wy, (SWP_NOCOPYBITS | SWP_NOZORDER | SWP_SHOWWINDOW));
+	SetForegroundWindow(data->h_window);
+	ShowWindow(data->h_window, SW_NORMAL);
 
 	//Ϣ
-	msg_dispatch();
+	win32_dispatch(window);
 
 	//ʼkeys, window_fbȫΪ0
 	memset(window->window_fb, 0, width * height * 4);
@@ -158,36 +170,38 @@ int window_init(int width, int height, const char *title)
 	return 0;
 }
 
-int window_destroy()
+static void win32_destroy(window_t *window)
 {
-	if (window->mem_dc)
+	win32_data_t *data = (win32_data_t *)window->native;
+	if (data->mem_dc)
 	{
-		if (window->bm_old)
+		if (data->bm_old)
 		{
-			SelectObject(window->mem_dc, window->bm_old); // дԭbitmapͷDC
-			window->bm_old = NULL;
+			SelectObject(data->mem_dc, data->bm_old); // дԭbitmapͷDC
+			data->bm_old = NULL;
 		}
-		DeleteDC(window->mem_dc);
-		window->mem_dc = NULL;
+		DeleteDC(data->mem_dc);
+		data->mem_dc = NULL;
 	}
-	if (window->bm_dib) 
+	if (data->bm_dib) 
 	{
-		DeleteObject(window->bm_dib);
-		window->bm_dib = NULL;
+		DeleteObject(data->bm_dib);
+		data->bm_dib = NULL;
 	}
-	if (window->h_window) 
+	if (data->h_window) 
 	{
-		CloseWindow(window->h_window);
-		window->h_window = NULL;
+		CloseWindow(data->h_window);
+		data->h_window = NULL;
 	}
 
-	free(window);
-	return 0;
+	free(data);
+	window->native = NULL;
+	window->window_fb = NULL;
 }
 
 
 
-void msg_dispatch() 
+static void win32_dispatch(window_t *window)
 {
 	MSG msg;
 	while (1) 
@@ -201,32 +215,33 @@ void msg_dispatch()
 	}
 }
 
-static void window_display() 
+static void window_display(window_t *window)
 {
+	win32_data_t *data = (win32_data_t *)window->native;
 	LOGFONT logfont; //ı
 	ZeroMemory(&logfont, sizeof(LOGFONT));
 	logfont.lfCharSet = ANSI_CHARSET;
 	logfont.lfHeight = 20; //ĴС
 	HFONT hFont = CreateFontIndirect(&logfont);
 
-	HDC hDC = GetDC(window->h_window);
+	HDC hDC = GetDC(data->h_window);
 	//ĿеϽ(x,y), ȣ߶ȣָ
-	SelectObject(window->mem_dc, hFont);
-	SetTextColor(window->mem_dc, RGB(190, 190, 190));
-	SetBkColor(window->mem_dc, RGB(80, 80, 80));
-	//TextOut(window->mem_dc, 300, 50, "Project Name:SRender", strlen("Project Name:SRender"));
-	//TextOut(window->mem_dc, 300, 80, "Author:Lei", strlen("Author:Lei Sun"));
-	TextOut(window->mem_dc, 20, 20, 
+	SelectObject(data->mem_dc, hFont);
+	SetTextColor(data->mem_dc, RGB(190, 190, 190));
+	SetBkColor(data->mem_dc, RGB(80, 80, 80));
+	//TextOut(data->mem_dc, 300, 50, "Project Name:SRender", strlen("Project Name:SRender"));
+	//TextOut(data->mem_dc, 300, 80, "Author:Lei", strlen("Author:Lei Sun"));
+	TextOut(data->mem_dc, 20, 20, 
 		"control:hold left buttion to rotate, right button to pan", 
 		strlen("Control:hold left buttion to rotate, right button to pan"));
 
 	// ѼDCݴDC
-	BitBlt(hDC, 0, 0, window->width, window->height, window->mem_dc, 0, 0, SRCCOPY);
-	ReleaseDC(window->h_window, hDC);
+	BitBlt(hDC, 0, 0, window->width, window->height, data->mem_dc, 0, 0, SRCCOPY);
+	ReleaseDC(data->h_window, hDC);
 	
 }
 
-void window_draw(unsigned char *framebuffer)
+static void win32_draw(window_t *window, unsigned char *framebuffer)
 {
 	int i, j;
 	for (int i = 0; i < window->height; i++)
@@ -239,34 +254,23 @@ void window_draw(unsigned char *framebuffer)
 			window->window_fb[index + 2] = framebuffer[index];
 		}
 	}
-	window_display();
+	window_display(window);
 }
 
-vec2 get_mouse_pos()
+static vec2 win32_mouse_pos(window_t *window)
 {
 	POINT point;
 	GetCursorPos(&point);
-	ScreenToClient(window->h_window, &point); // Ļռתڿռ
+	ScreenToClient(((win32_data_t *)window->native)->h_window, &point); // Ļռתڿռ
 	return vec2((float)point.x, (float)point.y);
 }
 
-/* misc platform functions */
-static double get_native_time(void) {
-	static double period = -1;
-	LARGE_INTEGER counter;
-	if (period < 0) {
-		LARGE_INTEGER frequency;
-		QueryPerformanceFrequency(&frequency);
-		period = 1 / (double)frequency.QuadPart;
-	}
-	QueryPerformanceCounter(&counter);
-	return counter.QuadPart * period;
-}
-
-float platform_get_time(void) {
-	static double initial = -1;
-	if (initial < 0) {
-		initial = get_native_time();
-	}
-	return (float)(get_native_time() - initial);
-}
+const window_backend_t win32_backend =
+{
+	"win32",
+	win32_init,
+	win32_destroy,
+	win32_draw,
+	win32_dispatch,
+	win32_mouse_pos,
+};
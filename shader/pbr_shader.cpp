@@ -77,7 +77,7 @@ static vec3 Reinhard_mapping(vec3& color)
 	return color;
 }
 
-static vec3 cal_normal(vec3 &normal, vec3 *world_coords, const vec2 *uvs, const vec2 &uv, TGAImage *normal_map)
+static vec3 cal_normal(vec3 &normal, const vec3 *world_coords, const vec2 *uvs, const vec2 &uv, TGAImage *normal_map)
 {
 	//calculate the difference in UV coordinate
 	float x1 = uvs[1][0] - uvs[0][0];
@@ -109,39 +109,30 @@ static vec3 cal_normal(vec3 &normal, vec3 *world_coords, const vec2 *uvs, const
 	return normal_new;
 }
 
-void PBRShader::vertex_shader(int nfaces, int nvertex)
+void PBRShader::vertex_shader(int nvertex, vertex_out_t &out) const
 {
-	int i = 0;
-	vec4 temp_vert = to_vec4(payload.model->vert(nfaces, nvertex), 1.0f);
-	vec4 temp_normal = to_vec4(payload.model->normal(nfaces, nvertex), 1.0f);
+	vec3 temp_vert = payload.model->vert(nvertex);
 
-	payload.uv_attri[nvertex] = payload.model->uv(nfaces, nvertex);
-	payload.in_uv[nvertex] = payload.uv_attri[nvertex];
-	payload.clipcoord_attri[nvertex] = payload.mvp_matrix * temp_vert;
-	payload.in_clipcoord[nvertex] = payload.clipcoord_attri[nvertex];
+	out.clipcoord = payload.mvp_matrix * to_vec4(temp_vert, 1.0f);
+	out.uv = payload.model->uv(nvertex);
 
 	//only model matrix can change normal vector
-	for (i = 0; i < 3; i++)
-	{
-		payload.worldcoord_attri[nvertex][i] = temp_vert[i];
-		payload.in_worldcoord[nvertex][i] = temp_vert[i];
-		payload.normal_attri[nvertex][i] = temp_normal[i];
-		payload.in_normal[nvertex][i] = temp_normal[i];
-	}
+	out.worldcoord = temp_vert;
+	out.normal = payload.model->normal(nvertex);
 }
 
 //ʱãδùԴ
-vec3 PBRShader::direct_fragment_shader(float alpha, float beta, float gamma)
+vec3 PBRShader::direct_fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const
 {
 	vec3 CookTorrance_brdf;
 	vec3 light_pos = vec3(2, 1.5, 5);
 	vec3 radiance = vec3(3,3,3);
 
 	//for reading easily
-	vec4 *clip_coords = payload.clipcoord_attri;
-	vec3 *world_coords = payload.worldcoord_attri;
-	vec3 *normals = payload.normal_attri;
-	vec2 *uvs = payload.uv_attri;
+	const vec4 *clip_coords = varying.clipcoord_attri;
+	const vec3 *world_coords = varying.worldcoord_attri;
+	const vec3 *normals = varying.normal_attri;
+	const vec2 *uvs = varying.uv_attri;
 
 	//interpolate attribute
 	float Z = 1.0 / (alpha / clip_coords[0].w() + beta / clip_coords[1].w() + gamma / clip_coords[2].w());
@@ -203,17 +194,17 @@ vec3 PBRShader::direct_fragment_shader(float alpha, float beta, float gamma)
 }
 
 //ibl_fragment_shader
-vec3 PBRShader::fragment_shader(float alpha, float beta, float gamma)
+vec3 PBRShader::fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const
 {
 	vec3 CookTorrance_brdf;
 	vec3 light_pos = vec3(2, 1.5, 5);
 	vec3 radiance = vec3(3, 3, 3);
 
 	//for reading easily
-	vec4 *clip_coords = payload.clipcoord_attri;
-	vec3 *world_coords = payload.worldcoord_attri;
-	vec3 *normals = payload.normal_attri;
-	vec2 *uvs = payload.uv_attri;
+	const vec4 *clip_coords = varying.clipcoord_attri;
+	const vec3 *world_coords = varying.worldcoord_attri;
+	const vec3 *normals = varying.normal_attri;
+	const vec2 *uvs = varying.uv_attri;
 
 	//interpolate attribute
 	float Z = 1.0 / (alpha / clip_coords[0].w() + beta / clip_coords[1].w() + gamma / clip_coords[2].w());
@@ -23,6 +23,16 @@ typedef struct iblmap
 	TGAImage *brdf_lut;
 } iblmap_t;
 
+//output of the vertex shader for one vertex of the model
+typedef struct
+{
+	vec4 clipcoord;
+	vec3 worldcoord;
+	vec3 normal;
+	vec2 uv;
+} vertex_out_t;
+
+//per-draw data shared by every thread, it is only read while a model is drawn
 typedef struct
 {
 	//light_matrix for shadow mapping, (to do)
@@ -36,6 +46,13 @@ typedef struct
 	Camera *camera;
 	Model *model;
 
+	//for image-based lighting
+	iblmap_t *iblmap;
+}payload_t;
+
+//per-thread triangle context, the clipped triangle currently being rasterized
+typedef struct
+{
 	//vertex attribute
 	vec3 normal_attri[3];
 	vec2 uv_attri[3];
@@ -51,38 +68,41 @@ typedef struct
 	vec2 out_uv[MAX_VERTEX];
 	vec3 out_worldcoord[MAX_VERTEX];
 	vec4 out_clipcoord[MAX_VERTEX];
-
-	//for image-based lighting
-	iblmap_t *iblmap;
-}payload_t;
+}varying_t;
 
 class IShader
 {
 public:
 	payload_t payload;
-	virtual void vertex_shader(int nfaces, int nvertex) {}
-	virtual vec3 fragment_shader(float alpha, float beta, float gamma) { return vec3(0, 0, 0); }
+	virtual ~IShader() {}
+	//copy with its own payload, frames drawn at the same time each bind their camera to a clone
+	virtual IShader *clone() const { return new IShader(*this); }
+	virtual void vertex_shader(int nvertex, vertex_out_t &out) const {}
+	virtual vec3 fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const { return vec3(0, 0, 0); }
 };
 
 class PhongShader:public IShader
 {
 public:
-	void vertex_shader(int nfaces, int nvertex);
-	vec3 fragment_shader(float alpha, float beta, float gamma);
+	IShader *clone() const { return new PhongShader(*this); }
+	void vertex_shader(int nvertex, vertex_out_t &out) const;
+	vec3 fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const;
 
 };
 
 class PBRShader :public IShader
 {
 public:
-	void vertex_shader(int nfaces, int nvertex);
-	vec3 fragment_shader(float alpha, float beta, float gamma);
-	vec3 direct_fragment_shader(float alpha, float beta, float gamma);
+	IShader *clone() const { return new PBRShader(*this); }
+	void vertex_shader(int nvertex, vertex_out_t &out) const;
+	vec3 fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const;
+	vec3 direct_fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const;
 };
 
 class SkyboxShader :public IShader
 {
 public:
-	void vertex_shader(int nfaces, int nvertex);
-	vec3 fragment_shader(float alpha, float beta, float gamma);
+	IShader *clone() const { return new SkyboxShader(*this); }
+	void vertex_shader(int nvertex, vertex_out_t &out) const;
+	vec3 fragment_shader(const varying_t &varying, float alpha, float beta, float gamma) const;
 };
\ No newline at end of file